@@ -0,0 +1,200 @@
+// Batched hand scoring library
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "cl.hpp"
+#include <omp.h>
+#include "batch.h"
+#include "score.h"
+
+using std::cerr;
+using std::endl;
+using std::flush;
+using std::string;
+using std::vector;
+using std::min;
+using std::make_pair;
+
+namespace {
+
+// Hands per device chunk, a multiple of 4 since the kernel scores 4 hands per work item.
+// Each device alternates between two chunks so that transfers for one overlap compute on the other.
+const size_t chunk_size = 1<<20;
+
+bool read_file(const string& path, string& contents) {
+    FILE* file = fopen(path.c_str(),"r");
+    if (!file)
+        return false;
+    struct stat st;
+    fstat(fileno(file),&st);
+    contents.assign(st.st_size,0);
+    bool ok = fread(&contents[0],st.st_size,1,file)==1 || !st.st_size;
+    fclose(file);
+    return ok;
+}
+
+}
+
+const char* const score_batch_t::kernel_names[score_batch_t::NUM_GAMES] = {"score_hands_kernel","score_ace_five_kernel","score_deuce_seven_kernel"};
+
+struct score_batch_t::state_t {
+    struct device_t {
+        cl::Device id;
+        bool unified; // Host and device share memory, so we can score straight out of the caller's buffers
+        cl::CommandQueue queues[2];
+        cl::Kernel kernels[2][NUM_GAMES];
+        cl::Buffer cards[2], scores[2]; // Only used if !unified
+    };
+
+    cl::Context context;
+    cl::Program program;
+    vector<device_t> devices;
+
+    bool initialize(int device_types, const char* dir, bool verbose) {
+        cl_int err;
+        context = cl::Context(device_types,0,0,0,&err);
+        if (err!=CL_SUCCESS)
+            return false;
+        vector<cl::Device> ids = context.getInfo<CL_CONTEXT_DEVICES>();
+        if (!ids.size())
+            return false;
+
+        // Load and build the program
+        string source;
+        if (!read_file(string(dir)+"/score.cl",source)) {
+            if (verbose)
+                cerr<<"batch: couldn't read \""<<dir<<"/score.cl\""<<endl;
+            return false;
+        }
+        const string options = string("-Werror -I")+dir;
+        cl::Program::Sources sources(1,make_pair(source.c_str(),source.size()));
+        program = cl::Program(context,sources);
+        if (program.build(ids,options.c_str())!=CL_SUCCESS) {
+            if (verbose)
+                for (size_t i = 0; i < ids.size(); i++)
+                    cerr<<"batch: build failed on device "<<i<<":\n"<<program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(ids[i])<<flush;
+            return false;
+        }
+
+        // Set up each device
+        devices.resize(ids.size());
+        for (size_t i = 0; i < ids.size(); i++) {
+            device_t& d = devices[i];
+            d.id = ids[i];
+            d.unified = d.id.getInfo<CL_DEVICE_HOST_UNIFIED_MEMORY>()!=0;
+            for (int s = 0; s < 2; s++) {
+                d.queues[s] = cl::CommandQueue(context,d.id);
+                if (!d.unified) {
+                    d.cards[s] = cl::Buffer(context,CL_MEM_READ_ONLY,chunk_size*sizeof(cards_t));
+                    d.scores[s] = cl::Buffer(context,CL_MEM_WRITE_ONLY,chunk_size*sizeof(score_t));
+                }
+                for (int g = 0; g < NUM_GAMES; g++) {
+                    d.kernels[s][g] = cl::Kernel(program,kernel_names[g]);
+                    if (!d.unified) {
+                        d.kernels[s][g].setArg(0,d.cards[s]);
+                        d.kernels[s][g].setArg(1,d.scores[s]);
+                    }
+                }
+            }
+        }
+        if (verbose) {
+            cerr<<"batch: scoring on "<<devices.size()<<" opencl "<<(devices.size()==1?"device: ":"devices: ");
+            for (size_t i = 0; i < devices.size(); i++)
+                cerr<<(i?", ":"")<<devices[i].id.getInfo<CL_DEVICE_NAME>()<<(devices[i].unified?" (zero copy)":"");
+            cerr<<endl;
+        }
+        return true;
+    }
+
+    // Enqueue one chunk of n hands (a multiple of 4) on the given slot of a device.  Nothing blocks.
+    void enqueue(device_t& d, int s, game_t game, size_t n, const cards_t* cards, score_t* scores) {
+        const cl::CommandQueue& queue = d.queues[s];
+        cl::Kernel& kernel = d.kernels[s][game];
+        if (d.unified) {
+            // Wrap the caller's memory directly.  Drivers may still copy if the pointers aren't suitably aligned,
+            // but the result is correct either way.  Mapping the output makes the scores visible on the host.
+            cl::Buffer in(context,CL_MEM_READ_ONLY|CL_MEM_USE_HOST_PTR,n*sizeof(cards_t),(void*)cards),
+                       out(context,CL_MEM_WRITE_ONLY|CL_MEM_USE_HOST_PTR,n*sizeof(score_t),scores);
+            kernel.setArg(0,in);
+            kernel.setArg(1,out);
+            queue.enqueueNDRangeKernel(kernel,cl::NullRange,cl::NDRange(n/4),cl::NullRange);
+            void* p = queue.enqueueMapBuffer(out,CL_FALSE,CL_MAP_READ,0,n*sizeof(score_t));
+            queue.enqueueUnmapMemObject(out,p);
+        } else {
+            // Transfer directly between the caller's memory and the device, with no intermediate host copy
+            queue.enqueueWriteBuffer(d.cards[s],CL_FALSE,0,n*sizeof(cards_t),cards);
+            queue.enqueueNDRangeKernel(kernel,cl::NullRange,cl::NDRange(n/4),cl::NullRange);
+            queue.enqueueReadBuffer(d.scores[s],CL_FALSE,0,n*sizeof(score_t),scores);
+        }
+    }
+};
+
+score_batch_t::score_batch_t(int device_types, const char* dir, bool verbose)
+    :state(new state_t) {
+    if (device_types && !state->initialize(device_types,dir,verbose)) {
+        if (verbose)
+            cerr<<"batch: no usable opencl devices, falling back to the host"<<endl;
+        state->devices.clear();
+    }
+}
+
+score_batch_t::~score_batch_t() {
+    delete state;
+}
+
+size_t score_batch_t::devices() const {
+    return state->devices.size();
+}
+
+void score_batch_t::score_host(size_t n, const cards_t* cards, score_t* scores, game_t game) {
+    // The evaluators are branch free, so the compiler is free to vectorize these loops
+    #define LOOP(score) \
+        _Pragma("omp parallel for") \
+        for (ptrdiff_t i = 0; i < (ptrdiff_t)n; i++) \
+            scores[i] = score(cards[i]);
+    switch (game) {
+        case HIGH:        LOOP(score_hand) break;
+        case ACE_FIVE:    LOOP(score_ace_five) break;
+        case DEUCE_SEVEN: LOOP(score_deuce_seven) break;
+        default: assert(false);
+    }
+    #undef LOOP
+}
+
+void score_batch_t::score(size_t n, const cards_t* cards, score_t* scores, game_t game) const {
+    state_t& s = *state;
+    if (!s.devices.size()) {
+        score_host(n,cards,scores,game);
+        return;
+    }
+
+    // Devices handle everything up to the last multiple of 4, pulling chunks off a shared counter
+    const size_t m = n&~size_t(3);
+    const size_t chunks = (m+chunk_size-1)/chunk_size;
+    size_t next = 0;
+    #pragma omp parallel num_threads(s.devices.size())
+    {
+        state_t::device_t& d = s.devices[omp_get_thread_num()];
+        for (int slot = 0;; slot ^= 1) {
+            size_t job;
+            #pragma omp critical
+            job = next++;
+            if (job>=chunks) break;
+            // Wait until this slot's previous chunk is done before reusing its buffers
+            d.queues[slot].finish();
+            const size_t start = job*chunk_size;
+            s.enqueue(d,slot,game,min(chunk_size,m-start),cards+start,scores+start);
+            d.queues[slot].flush();
+        }
+        d.queues[0].finish();
+        d.queues[1].finish();
+    }
+
+    // Fill in the ragged tail
+    score_host(n-m,cards+m,scores+m,game);
+}
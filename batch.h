@@ -0,0 +1,52 @@
+// Batched hand scoring library
+//
+// Scores arbitrarily many hands using every available OpenCL device, falling back to the host
+// if OpenCL is unavailable.  Cards and scores use the same representation as score.h: a 52-entry
+// bit set in suit-value major order, and a 32-bit score where larger is better (also for lowball).
+
+#ifndef __batch_h__
+#define __batch_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Same as score.h
+typedef uint64_t cards_t;
+typedef uint32_t score_t;
+
+class score_batch_t {
+    struct state_t;
+    state_t* state;
+public:
+    // Hand evaluators
+    enum game_t {
+        HIGH,        // Best high hand out of 7 cards (score_hand)
+        ACE_FIVE,    // Best A-5 low hand out of 5 to 7 cards (score_ace_five)
+        DEUCE_SEVEN, // 2-7 low hand of exactly 5 cards (score_deuce_seven)
+        NUM_GAMES
+    };
+
+    // The score.cl kernel for each game
+    static const char* const kernel_names[NUM_GAMES];
+
+    // Set up all OpenCL devices of the given types (a CL_DEVICE_TYPE_* mask, or 0 for host only).
+    // score.cl is loaded from the given directory.  If no device can be used, we quietly fall back to the host.
+    score_batch_t(int device_types, const char* dir=".", bool verbose=false);
+    ~score_batch_t();
+
+    // The number of OpenCL devices in use, or zero if we're scoring on the host
+    size_t devices() const;
+
+    // Score n hands.  Both arrays are owned by the caller and must stay valid until score returns.
+    // Input is streamed to the devices in overlapping chunks, so n can be arbitrarily large.
+    void score(size_t n, const cards_t* cards, score_t* scores, game_t game=HIGH) const;
+
+    // Score on the host only
+    static void score_host(size_t n, const cards_t* cards, score_t* scores, game_t game=HIGH);
+
+private:
+    score_batch_t(const score_batch_t&); // noncopyable
+    void operator=(const score_batch_t&);
+};
+
+#endif
@@ -0,0 +1,67 @@
+// Precomputed equity vs. a random hand
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "equity_table.h"
+
+using std::cerr;
+using std::endl;
+
+equity_table_header_t equity_table_header_t::make(int board) {
+    assert(board==4 || board==5);
+    const int rounds[2] = {2,board};
+    equity_table_header_t h;
+    memset(&h,0,sizeof(h));
+    strcpy(h.magic,"equity1");
+    h.board = board;
+    // Opponents come from the 45 cards left after the river, and turn entries sum over 46 rivers
+    const uint64_t opponents = 45*44/2, runouts = board==4?46:1;
+    h.scale = 2*runouts*opponents;
+    h.bytes = h.scale<(1<<16)?2:4;
+    h.size = hand_indexer_t(2,rounds).size();
+    return h;
+}
+
+bool equity_table_header_t::operator==(const equity_table_header_t& h) const {
+    return !memcmp(magic,h.magic,sizeof(magic)) && board==h.board && bytes==h.bytes && size==h.size && scale==h.scale;
+}
+
+equity_table_t::equity_table_t(const char* path)
+    :header(0),data(0),length(0),indexer(0) {
+    const int fd = open(path,O_RDONLY);
+    struct stat st;
+    if (fd<0 || fstat(fd,&st)<0) {
+        cerr<<"equity table: can't open \""<<path<<"\""<<endl;
+        if (fd>=0) close(fd);
+        return;
+    }
+    length = st.st_size;
+    void* p = length>=sizeof(equity_table_header_t)?mmap(0,length,PROT_READ,MAP_SHARED,fd,0):MAP_FAILED;
+    close(fd);
+    if (p==MAP_FAILED) {
+        cerr<<"equity table: can't map \""<<path<<"\""<<endl;
+        return;
+    }
+    header = (const equity_table_header_t*)p;
+    if (!((header->board==4 || header->board==5) && *header==equity_table_header_t::make(header->board))
+        || length!=sizeof(equity_table_header_t)+header->bytes*header->size) {
+        cerr<<"equity table: \""<<path<<"\" is not a valid equity table"<<endl;
+        munmap(p,length);
+        header = 0;
+        return;
+    }
+    data = header+1;
+    const int rounds[2] = {2,int(header->board)};
+    indexer = new hand_indexer_t(2,rounds);
+}
+
+equity_table_t::~equity_table_t() {
+    delete indexer;
+    if (header)
+        munmap((void*)header,length);
+}
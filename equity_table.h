@@ -0,0 +1,61 @@
+// Precomputed equity vs. a random hand
+//
+// Tables written by "exact table" hold the exact equity vs. a uniformly random opponent of every hold'em hand on the
+// turn or river, up to suit permutation.  Entries are indexed by hand_indexer_t with the hole cards and the whole
+// board as two rounds, and hold twice the wins plus the ties summed over all runouts and opponent holdings, so that
+// equity is entry/scale.  An equity_table_t maps the file read only, so a lookup costs one index computation and one
+// memory load.
+
+#ifndef __equity_table_h__
+#define __equity_table_h__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hand_index.h"
+
+struct equity_table_header_t {
+    char magic[8];   // "equity1" followed by a null
+    uint32_t board;  // Number of board cards: 4 for the turn or 5 for the river
+    uint32_t bytes;  // Bytes per entry: 2 or 4
+    uint64_t size;   // Number of entries
+    uint64_t scale;  // Entry for an equity of 1
+
+    // Header for a table with the given number of board cards
+    static equity_table_header_t make(int board);
+
+    bool operator==(const equity_table_header_t& h) const;
+};
+
+class equity_table_t {
+    const equity_table_header_t* header;
+    const void* data;
+    size_t length;
+    hand_indexer_t* indexer;
+public:
+    // Map a table written by "exact table".  On failure, prints a message to cerr and leaves the table invalid.
+    explicit equity_table_t(const char* path);
+    ~equity_table_t();
+
+    bool valid() const { return data!=0; }
+
+    // Number of board cards
+    int board() const { return header->board; }
+
+    // Twice the wins plus the ties of hole vs. a random hand, summed over runouts and opponents
+    uint32_t entry(cards_t hole, cards_t board) const {
+        const cards_t cards[2] = {hole,board};
+        const uint64_t i = indexer->index(cards);
+        return header->bytes==2?((const uint16_t*)data)[i]:((const uint32_t*)data)[i];
+    }
+
+    // Equity of hole vs. a random hand given the board
+    double equity(cards_t hole, cards_t board) const {
+        return double(entry(hole,board))/header->scale;
+    }
+
+private:
+    equity_table_t(const equity_table_t&); // noncopyable
+    void operator=(const equity_table_t&);
+};
+
+#endif
@@ -9,10 +9,16 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "cl.hpp"
 #include <omp.h>
 #include <getopt.h>
 #include "score.h"
+#include "batch.h"
+#include "hand_index.h"
+#include "equity_table.h"
 
 using std::ostream;
 using std::cin;
@@ -102,7 +108,19 @@ inline uint64_t popcount(uint64_t x) {
     return __builtin_popcountl(x);
 }
 
-const char* show_type(score_t type) {
+// Short deck (6+) hold'em removes the 2s through 5s, so A-6-7-8-9 is the lowest straight and flushes beat full houses
+enum deck_t { FULL_DECK, SHORT_DECK };
+
+// Number of boards for each matchup
+inline int deck_boards(deck_t deck) {
+    return deck==SHORT_DECK?NUM_SHORT_BOARDS:NUM_FIVE_SUBSETS;
+}
+
+const char* show_type(score_t type, deck_t deck=FULL_DECK) {
+    if (deck==SHORT_DECK && type==SHORT_FLUSH)
+        return "flush";
+    if (deck==SHORT_DECK && type==SHORT_FULL_HOUSE)
+        return "full-house";
     switch (type) {
         case HIGH_CARD:      return "high-card";
         case PAIR:           return "pair";
@@ -166,13 +184,13 @@ public:
         fflush(stderr);
     }
 
-private:
     static double current_time() {
         timeval tv;
         gettimeofday(&tv,0);
         return tv.tv_sec+1e-6*tv.tv_usec;
     }
 
+private:
     static void dump_width(int depth, node_id node, int& width) {
         const unordered_map<const char*,node_id>& c = children[node];
         vector<pair<node_id,const char*> > ids;
@@ -204,8 +222,9 @@ timer_t::node_id timer_t::current = 0;
 unordered_map<timer_t::node_id,unordered_map<const char*,timer_t::node_id> > timer_t::children;
 unordered_map<timer_t::node_id,double> timer_t::time;
 
+// Win/loss/tie counts, wide enough that large enumerations can't overflow
 struct outcomes_t {
-    uint32_t alice,bob,tie;
+    uint64_t alice,bob,tie;
 
     outcomes_t()
         :alice(0),bob(0),tie(0) {}
@@ -215,13 +234,25 @@ struct outcomes_t {
         return *this;
     }
 
-    uint32_t total() const {
+    // Add wins packed as in compare_cards, counting each one multiplicity times.  Ties are left to the caller.
+    void add_wins(uint64_t packed, uint64_t multiplicity=1) {
+        alice += multiplicity*(packed>>32);
+        bob += multiplicity*uint32_t(packed);
+    }
+
+    uint64_t total() const {
         return alice+bob+tie;
     }
 };
 
+// compare_cards packs Alice's wins into the high 32 bits and Bob's into the low 32 bits, so packed sums are exact
+// only while fewer than 2^32 outcomes are added.  We sum packed within one matchup, and switch to outcomes_t across
+// matchups.  If an enumeration ever grows past this limit, this line will fail to compile.
+typedef char packed_sums_are_exact[NUM_FIVE_SUBSETS<((uint64_t)1<<32)?1:-1];
+
 // To make parallelization easy, we precompute the set of 5 element subsets of 48 elements.
-five_subset_t five_subsets[NUM_FIVE_SUBSETS];
+// The zero padding at the end keeps vector loads in the last (ragged) block in bounds.
+five_subset_t five_subsets[NUM_FIVE_SUBSETS+8];
 
 void compute_five_subsets() {
     int n = 0;
@@ -233,18 +264,183 @@ void compute_five_subsets() {
                         five_subsets[n++] = i0|i1<<6|i2<<12|i3<<18|i4<<24;
 }
 
+inline uint32_t bit_stack(bool b0, bool b1, bool b2, bool b3) {
+    return b0|b1<<1|b2<<2|b3<<3;
+}
+
+uint64_t total_comparisons = 0;
+
+// A pair of hands reduced to the matchups we actually need to evaluate
+struct plan_t {
+    deck_t deck;
+    uint64_t total; // Total number of outcomes, counting all of Bob's suit choices
+    int m; // Number of distinct matchups
+    int count[16]; // Number of Bob's suit choices equivalent to each matchup
+    int index[16]; // Map from suit signature to matchup, or -1 if the signature is impossible
+    matchup_t matchups[16];
+};
+
+// Outcomes of a pair of hands for each suit signature, not scaled by the number of equivalent suit choices
+struct signatures_t {
+    outcomes_t outcomes[16];
+};
+
+// Consider all possible sets of shared cards to determine the probabilities of wins, losses, and ties.
+// For efficiency, the set of shared cards is generated in decreasing order (this saves a factor of 5! = 120).
+// Also, only the 4 suit equality bits between Alice's and Bob's cards matter, so we need one matchup per signature.
+void plan_hands(hand_t alice, hand_t bob, plan_t& plan, deck_t deck=FULL_DECK) {
+    plan.deck = deck;
+    plan.total = 0;
+    plan.m = 0;
+    for (int sig = 0; sig < 16; sig++)
+        plan.index[sig] = -1;
+    // We fix the suits of Alice's cards
+    const int sa0 = 0, sa1 = !alice.suited;
+    const cards_t alice_cards = (cards_t(1)<<(alice.card0+13*sa0))|(cards_t(1)<<(alice.card1+13*sa1));
+    // Consider all compatible suits of Bob's cards
+    for (int sb0 = 0; sb0 < 4; sb0++)
+        for (int sb1 = 0; sb1 < 4; sb1++)
+            if ((sb0==sb1)==bob.suited) {
+                const cards_t bob_cards = (cards_t(1)<<(bob.card0+13*sb0))|(cards_t(1)<<(bob.card1+13*sb1));
+                const cards_t hand_cards = alice_cards|bob_cards;
+                // Make sure we don't use the same card twice
+                if (popcount(hand_cards)<4) continue;
+                plan.total += deck_boards(deck);
+                // Did we already do this one?
+                int& i = plan.index[bit_stack(sa0==sb0,sa0==sb1,sa1==sb0,sa1==sb1)];
+                if (i>=0) {
+                    plan.count[i]++;
+                    continue;
+                }
+                i = plan.m++;
+                plan.count[i] = 1;
+                matchup_t& m = plan.matchups[i];
+                m.alice_cards = alice_cards;
+                m.bob_cards = bob_cards;
+                // Make a list of the cards we're allowed to use
+                for (int c = 0, j = 0; c < 52; c++)
+                    if (!((cards_t(1)<<c)&hand_cards) && (deck!=SHORT_DECK || c%13>=4))
+                        m.free[j++] = cards_t(1)<<c;
+            }
+}
+
 // OpenCL information
 cl::Context context;
-cl::Program program;
+
+// A device buffer together with a host view of its contents.  Normally the host view is pinned staging memory
+// (CL_MEM_ALLOC_HOST_PTR), mapped once at startup, so that copies to and from the device run at full DMA speed
+// and never block.  On devices which share memory with the host, we skip staging and map the device buffer itself.
+struct transfer_t {
+    cl::Buffer device;
+    cl::Buffer pinned; // Unused if unified
+    void* host; // Mapped pinned memory, or the current mapping of device if unified
+    bool unified;
+
+    transfer_t()
+        :host(0),unified(false) {}
+
+    void allocate(const cl::CommandQueue& queue, bool unified_, cl_mem_flags flags, size_t size) {
+        unified = unified_;
+        if (unified) {
+            device = cl::Buffer(context,flags|CL_MEM_ALLOC_HOST_PTR,size);
+            host = 0;
+        } else {
+            device = cl::Buffer(context,flags,size);
+            pinned = cl::Buffer(context,CL_MEM_READ_WRITE|CL_MEM_ALLOC_HOST_PTR,size);
+            host = queue.enqueueMapBuffer(pinned,CL_TRUE,CL_MAP_READ|CL_MAP_WRITE,0,size);
+        }
+    }
+
+    // Get host memory to fill before calling end_write
+    void* begin_write(const cl::CommandQueue& queue, size_t size) {
+        if (unified)
+            host = queue.enqueueMapBuffer(device,CL_TRUE,CL_MAP_WRITE,0,size);
+        return host;
+    }
+
+    // Send host memory to the device without blocking
+    void end_write(const cl::CommandQueue& queue, size_t size, cl::Event* event=0) {
+        if (unified) {
+            queue.enqueueUnmapMemObject(device,host,0,event);
+            host = 0;
+        } else
+            queue.enqueueWriteBuffer(device,CL_FALSE,0,size,host,0,event);
+    }
+
+    // Start bringing device memory back to the host.  The host view is valid once event completes.
+    void begin_read(const cl::CommandQueue& queue, size_t size, cl::Event* event) {
+        if (unified)
+            host = queue.enqueueMapBuffer(device,CL_FALSE,CL_MAP_READ,0,size,0,event);
+        else
+            queue.enqueueReadBuffer(device,CL_FALSE,0,size,host,0,event);
+    }
+
+    // Release the host view after begin_read
+    void end_read(const cl::CommandQueue& queue) {
+        if (unified) {
+            queue.enqueueUnmapMemObject(device,host);
+            host = 0;
+        }
+    }
+};
+
+// Kernel parameters, tuned separately for each device
+struct config_t {
+    int block_size; // Number of five subsets summed by each work item
+    int vector_width; // Number of lanes in each vector type
+    int group_size; // Work-group size, or zero to let OpenCL choose
+
+    config_t()
+        :block_size(256),vector_width(4),group_size(0) {}
+
+    // Build options which specialize score.cl to this configuration
+    string options() const {
+        char s[128];
+        snprintf(s,sizeof(s),"-DBLOCK_SIZE=%d -DVECTOR_WIDTH=%d",block_size,vector_width);
+        return s;
+    }
+
+    // Number of work items along the first dimension of compare_matchups_kernel, padded to a multiple of the group size
+    size_t blocks(size_t boards=NUM_FIVE_SUBSETS) const {
+        const size_t n = (boards+block_size-1)/block_size;
+        return group_size?(n+group_size-1)/group_size*group_size:n;
+    }
+
+    // Local size for a kernel whose first global dimension is n
+    cl::NDRange local(size_t n, bool two_dimensional=false) const {
+        if (!group_size || n%group_size)
+            return cl::NullRange;
+        return two_dimensional?cl::NDRange(group_size,1):cl::NDRange(group_size);
+    }
+
+    friend ostream& operator<<(ostream& out, const config_t& c) {
+        out<<"block "<<c.block_size<<", width "<<c.vector_width<<", group ";
+        if (c.group_size)
+            return out<<c.group_size;
+        return out<<"auto";
+    }
+};
+
+// Pairs of hands are evaluated in batches, with one kernel launch per batch.  Each pair needs at most 16 matchups,
+// one for each distinct suit signature.
+const size_t hands_per_launch = 16;
+const size_t max_matchups = 16*hands_per_launch;
+
 struct device_t {
     cl::Device id;
-    cl::CommandQueue queue;
-    cl::Kernel score_hands;
-    cl::Buffer cards;
-    cl::Kernel compare_cards;
+    config_t config;
+    cl::Program program;
+    // Each device has two slots with separate queues, so that transfers for one slot overlap compute on the other
+    cl::CommandQueue queues[2];
+    cl::Kernel score_hands[score_batch_t::NUM_GAMES];
+    transfer_t cards;
+    cl::Kernel compare_matchups[2];
+    cl::Kernel compare_short[2];
     cl::Buffer five_subsets;
-    cl::Buffer free;
-    cl::Buffer results;
+    transfer_t matchups[2];
+    transfer_t results[2];
+    cl::Event done[2];
+    cl::Kernel compare_omaha, compare_omaha8; // Use slot 0
     cl::Kernel hash_scores;
 
     bool operator<(const device_t& d) const {
@@ -258,7 +454,133 @@ struct device_t {
 vector<device_t> devices;
 
 const size_t max_cards = 20<<17;
-const size_t result_space = max(sizeof(score_t)*max_cards,sizeof(uint64_t)*NUM_FIVE_SUBSETS/BLOCK_SIZE);
+
+size_t result_space(const config_t& config) {
+    return max(sizeof(score_t)*max_cards,sizeof(uint64_t)*max_matchups*config.blocks());
+}
+
+// Rerun the autotuner even if we have saved settings
+bool retune = false;
+
+// Autotuner results are saved here, one device per line
+const char* const tune_file = "tune.txt";
+
+string device_key(const cl::Device& id) {
+    return string(id.getInfo<CL_DEVICE_NAME>().c_str())+", "+id.getInfo<CL_DRIVER_VERSION>().c_str();
+}
+
+unordered_map<string,config_t> load_configs() {
+    unordered_map<string,config_t> configs;
+    FILE* file = fopen(tune_file,"r");
+    if (!file)
+        return configs;
+    config_t c;
+    char key[1024];
+    while (fscanf(file,"%d %d %d %1023[^\n]\n",&c.block_size,&c.vector_width,&c.group_size,key)==4)
+        configs[key] = c;
+    fclose(file);
+    return configs;
+}
+
+void save_configs(const unordered_map<string,config_t>& configs) {
+    FILE* file = fopen(tune_file,"w");
+    if (!file) {
+        cerr<<"warning: couldn't write autotuner results to \""<<tune_file<<"\""<<endl;
+        return;
+    }
+    for (unordered_map<string,config_t>::const_iterator i = configs.begin(), e = configs.end(); i != e; ++i)
+        fprintf(file,"%d %d %d %s\n",i->second.block_size,i->second.vector_width,i->second.group_size,i->first.c_str());
+    fclose(file);
+}
+
+// Build score.cl for one device, specialized to the given configuration
+bool build_program(const string& source, const cl::Device& id, const config_t& config, cl::Program& program) {
+    char options[2048] = "-Werror -I";
+    getcwd(options+strlen(options),2048-strlen(options));
+    snprintf(options+strlen(options),2048-strlen(options)," %s",config.options().c_str());
+    cl::Program::Sources sources(1,make_pair(source.c_str(),strlen(source.c_str())));
+    program = cl::Program(context,sources);
+    return program.build(vector<cl::Device>(1,id),options)==CL_SUCCESS;
+}
+
+// Benchmark a grid of kernel parameters on one device, and return the fastest.  Each configuration is checked against
+// results computed on the host, so a miscompiled configuration can't win.
+config_t tune_device(device_t& d, const string& source, bool verbose) {
+    timer_t timer("tune");
+    const int block_sizes[] = {128,256,512,1024},
+              vector_widths[] = {2,4,8},
+              group_sizes[] = {0,32,64,128,256};
+    if (verbose)
+        cerr<<"tuning "<<d.id.getInfo<CL_DEVICE_NAME>()<<endl;
+    const cl::CommandQueue& queue = d.queues[0];
+
+    // Benchmark on AKs vs. 22, which has several distinct suit signatures
+    plan_t plan;
+    plan_hands(hand_t(12,11,1),hand_t(0,0,0),plan);
+    const size_t total = plan.m;
+    cl::Buffer five(context,CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR,sizeof(five_subsets),five_subsets);
+    cl::Buffer matchups(context,CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR,total*sizeof(matchup_t),plan.matchups);
+    const size_t most_blocks = NUM_FIVE_SUBSETS/block_sizes[0]+1+group_sizes[sizeof(group_sizes)/sizeof(int)-1];
+    cl::Buffer results(context,CL_MEM_WRITE_ONLY,sizeof(uint64_t)*most_blocks*total);
+    vector<uint64_t> host(most_blocks*total);
+
+    // Compute the expected sum of packed outcomes on the host
+    uint64_t expected = 0;
+    #pragma omp parallel for reduction(+:expected)
+    for (int i = 0; i < NUM_FIVE_SUBSETS; i++)
+        for (size_t j = 0; j < total; j++) {
+            const matchup_t& m = plan.matchups[j];
+            expected += compare_cards(m.alice_cards,m.bob_cards,m.free,five_subsets[i]);
+        }
+
+    config_t best;
+    double best_time = 1e100;
+    for (size_t b = 0; b < sizeof(block_sizes)/sizeof(int); b++)
+        for (size_t w = 0; w < sizeof(vector_widths)/sizeof(int); w++) {
+            config_t c;
+            c.block_size = block_sizes[b];
+            c.vector_width = vector_widths[w];
+            cl::Program program;
+            if (!build_program(source,d.id,c,program))
+                continue;
+            cl::Kernel kernel(program,"compare_matchups_kernel");
+            kernel.setArg(0,five);
+            kernel.setArg(1,matchups);
+            kernel.setArg(2,results);
+            const size_t max_group = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(d.id);
+            for (size_t g = 0; g < sizeof(group_sizes)/sizeof(int); g++) {
+                c.group_size = group_sizes[g];
+                if (size_t(c.group_size)>max_group)
+                    continue;
+                const cl::NDRange global(c.blocks(),total), local = c.local(c.blocks(),true);
+                // Run once to warm up, then time a second run
+                if (queue.enqueueNDRangeKernel(kernel,cl::NullRange,global,local)!=CL_SUCCESS || queue.finish()!=CL_SUCCESS)
+                    continue;
+                const double start = timer_t::current_time();
+                queue.enqueueNDRangeKernel(kernel,cl::NullRange,global,local);
+                queue.finish();
+                const double time = timer_t::current_time()-start;
+                // Check results
+                queue.enqueueReadBuffer(results,CL_TRUE,0,sizeof(uint64_t)*c.blocks()*total,&host[0]);
+                uint64_t sum = 0;
+                for (size_t i = 0; i < c.blocks()*total; i++)
+                    sum += host[i];
+                if (sum!=expected) {
+                    cerr<<"warning: skipping configuration "<<c<<" due to incorrect results"<<endl;
+                    continue;
+                }
+                if (verbose)
+                    cerr<<"  "<<c<<": "<<time<<" s"<<endl;
+                if (best_time>time) {
+                    best_time = time;
+                    best = c;
+                }
+            }
+        }
+    if (verbose)
+        cerr<<"  best: "<<best<<endl;
+    return best;
+}
 
 void initialize_opencl(int device_types, bool verbose=true) {
     timer_t timer("opencl");
@@ -284,7 +606,7 @@ void initialize_opencl(int device_types, bool verbose=true) {
         cerr<<endl;
     }
 
-    // Load and build the program
+    // Load the program
     FILE* file = fopen("score.cl","r");
     if (!file) {
         cerr<<"error: couldn't open \"score.cl\" for reading"<<endl;
@@ -295,152 +617,260 @@ void initialize_opencl(int device_types, bool verbose=true) {
     string source(st.st_size+1,0);
     fread(&source[0],st.st_size,1,file);
     fclose(file);
-    char options[2048] = "-Werror -I";
-    getcwd(options+strlen(options),2048-strlen(options));
-    cl::Program::Sources sources(1,make_pair(source.c_str(),strlen(source.c_str())));
-    program = cl::Program(context,sources);
-    {
-        timer_t timer("build");
-        int status = program.build(ids,options);
-        if (status!=CL_SUCCESS) {
-            assert(status==CL_BUILD_PROGRAM_FAILURE);
-            cerr<<"error: failed to build opencl code"<<endl;
-            for (size_t i = 0; i < devices.size(); i++)
-                cerr<<"device "<<i<<":\n"<<program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(devices[i].id)<<flush;
-            exit(1);
-        }
-    }
 
     // Set up each device
+    unordered_map<string,config_t> configs = load_configs();
     for (size_t i = 0; i < devices.size(); i++) {
         device_t& d = devices.at(i);
-        // Make a command queue
-        d.queue = cl::CommandQueue(context,d.id);
+        const bool unified = d.id.getInfo<CL_DEVICE_HOST_UNIFIED_MEMORY>()!=0;
+        // Make command queues
+        for (int s = 0; s < 2; s++)
+            d.queues[s] = cl::CommandQueue(context,d.id);
+        // Pick kernel parameters, autotuning if we haven't seen this device before
+        const string key = device_key(d.id);
+        if (retune || !configs.count(key)) {
+            configs[key] = tune_device(d,source,verbose);
+            save_configs(configs);
+        }
+        d.config = configs[key];
+        if (verbose)
+            cerr<<"device "<<i<<": "<<d.config<<endl;
+        // Build the program
+        {
+            timer_t timer("build");
+            if (!build_program(source,d.id,d.config,d.program)) {
+                cerr<<"error: failed to build opencl code for device "<<i<<":\n"<<d.program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(d.id)<<flush;
+                exit(1);
+            }
+        }
         // Make the kernels
-        d.score_hands = cl::Kernel(program,"score_hands_kernel");
-        d.compare_cards = cl::Kernel(program,"compare_cards_kernel",0);
-        d.hash_scores = cl::Kernel(program,"hash_scores_kernel",0);
+        for (int g = 0; g < score_batch_t::NUM_GAMES; g++)
+            d.score_hands[g] = cl::Kernel(d.program,score_batch_t::kernel_names[g]);
+        for (int s = 0; s < 2; s++) {
+            d.compare_matchups[s] = cl::Kernel(d.program,"compare_matchups_kernel",0);
+            d.compare_short[s] = cl::Kernel(d.program,"compare_short_kernel",0);
+        }
+        d.compare_omaha = cl::Kernel(d.program,"compare_omaha_kernel",0);
+        d.compare_omaha8 = cl::Kernel(d.program,"compare_omaha8_kernel",0);
+        d.hash_scores = cl::Kernel(d.program,"hash_scores_kernel",0);
         // Allocate device arrays
-        assert(max_cards*sizeof(score_t)<=result_space);
-        d.cards = cl::Buffer(context,CL_MEM_READ_ONLY,max_cards*sizeof(cards_t));
+        const size_t space = result_space(d.config);
+        assert(max_cards*sizeof(score_t)<=space);
+        d.cards.allocate(d.queues[0],unified,CL_MEM_READ_ONLY,max_cards*sizeof(cards_t));
         d.five_subsets = cl::Buffer(context,CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR,sizeof(five_subsets),five_subsets);
-        d.free = cl::Buffer(context,CL_MEM_READ_ONLY,48*sizeof(cards_t));
-        d.results = cl::Buffer(context,CL_MEM_WRITE_ONLY,result_space);
+        for (int s = 0; s < 2; s++) {
+            d.matchups[s].allocate(d.queues[s],unified,CL_MEM_READ_ONLY,max_matchups*sizeof(matchup_t));
+            d.results[s].allocate(d.queues[s],unified,CL_MEM_WRITE_ONLY,space);
+        }
         // Set constant parameters
-        d.score_hands.setArg(0,d.cards);
-        d.score_hands.setArg(1,d.results);
-        d.compare_cards.setArg(0,d.five_subsets);
-        d.compare_cards.setArg(1,d.free);
-        d.compare_cards.setArg(2,d.results);
-        d.hash_scores.setArg(0,d.results);
+        for (int g = 0; g < score_batch_t::NUM_GAMES; g++) {
+            d.score_hands[g].setArg(0,d.cards.device);
+            d.score_hands[g].setArg(1,d.results[0].device);
+        }
+        for (int s = 0; s < 2; s++) {
+            cl::Kernel* kernels[2] = {&d.compare_matchups[s],&d.compare_short[s]};
+            for (int k = 0; k < 2; k++) {
+                kernels[k]->setArg(0,d.five_subsets);
+                kernels[k]->setArg(1,d.matchups[s].device);
+                kernels[k]->setArg(2,d.results[s].device);
+            }
+        }
+        cl::Kernel* omaha[2] = {&d.compare_omaha,&d.compare_omaha8};
+        for (int k = 0; k < 2; k++) {
+            omaha[k]->setArg(0,d.five_subsets);
+            omaha[k]->setArg(1,d.matchups[0].device);
+            omaha[k]->setArg(2,d.results[0].device);
+        }
+        d.hash_scores.setArg(0,d.results[0].device);
     }
 }
 
 // Score a bunch of hands in parallel using OpenCL
-void score_hands_opencl(size_t device, size_t n, score_t* scores, const cards_t* cards) {
+void score_hands_opencl(size_t device, size_t n, score_t* scores, const cards_t* cards, score_batch_t::game_t game=score_batch_t::HIGH) {
     assert(n <= max_cards);
-    const device_t& d = devices.at(device);
-    size_t count = (n+3)/4;
-    d.queue.enqueueWriteBuffer(d.cards,CL_TRUE,0,n*sizeof(cards_t),cards);
-    d.queue.enqueueNDRangeKernel(d.score_hands,cl::NullRange,cl::NDRange(count),cl::NullRange);
-    d.queue.enqueueReadBuffer(d.results,CL_TRUE,0,n*sizeof(score_t),scores);
+    device_t& d = devices.at(device);
+    const cl::CommandQueue& queue = d.queues[0];
+    const size_t width = d.config.vector_width;
+    size_t count = (n+width-1)/width;
+    memcpy(d.cards.begin_write(queue,n*sizeof(cards_t)),cards,n*sizeof(cards_t));
+    d.cards.end_write(queue,n*sizeof(cards_t));
+    queue.enqueueNDRangeKernel(d.score_hands[game],cl::NullRange,cl::NDRange(count),cl::NullRange);
+    cl::Event event;
+    d.results[0].begin_read(queue,n*sizeof(score_t),&event);
+    event.wait();
+    memcpy(scores,d.results[0].host,n*sizeof(score_t));
+    d.results[0].end_read(queue);
 }
 
 // Hash a bunch of hands in parallel using OpenCL
 void hash_scores_opencl(size_t device, size_t n, uint64_t* hashes) {
-    assert(sizeof(uint64_t)*n <= result_space);
     device_t& d = devices.at(device);
+    const cl::CommandQueue& queue = d.queues[0];
     const size_t batch = 1<<14;
+    assert(sizeof(uint64_t)*batch <= result_space(d.config));
     for (size_t i = 0; i < n; i += batch) {
         size_t count = min(batch,n-i);
         d.hash_scores.setArg(1,i);
-        d.queue.enqueueNDRangeKernel(d.hash_scores,cl::NullRange,cl::NDRange(count),cl::NullRange);
-        d.queue.enqueueReadBuffer(d.results,CL_TRUE,0,count*sizeof(uint64_t),hashes+i);
+        queue.enqueueNDRangeKernel(d.hash_scores,cl::NullRange,cl::NDRange(count),d.config.local(count));
+        cl::Event event;
+        d.results[0].begin_read(queue,count*sizeof(uint64_t),&event);
+        event.wait();
+        memcpy(hashes+i,d.results[0].host,count*sizeof(uint64_t));
+        d.results[0].end_read(queue);
         if ((n/batch)%max(size_t(1),n/batch/1024)==0)
             cout<<'.'<<flush;
     }
     cout<<endl;
 }
 
-// Process all five subsets in parallel using OpenCL
-uint64_t compare_cards_opencl(size_t device, cards_t alice_cards, cards_t bob_cards, const cards_t* free) {
+// Start evaluating all matchups from a batch of plans on one slot of a device, without waiting for the results.
+// All plans in a batch must use the same deck.
+void compare_plans_start(size_t device, int slot, size_t count, const plan_t* plans) {
     device_t& d = devices.at(device);
-    // Set arguments
-    {timer_t timer("set args");
-    d.compare_cards.setArg(3,alice_cards);
-    d.compare_cards.setArg(4,bob_cards);}
-    // Copy free to device
-    {timer_t timer("write free");
-    d.queue.enqueueWriteBuffer(d.free,CL_TRUE,0,48*sizeof(cards_t),free);}
-    // Compute
-    const size_t n = NUM_FIVE_SUBSETS/BLOCK_SIZE;
-    //const size_t n = (NUM_FIVE_SUBSETS+BLOCK_SIZE-1)/BLOCK_SIZE;
+    const cl::CommandQueue& queue = d.queues[slot];
+    const deck_t deck = count?plans[0].deck:FULL_DECK;
+    size_t total = 0;
+    for (size_t p = 0; p < count; p++) {
+        assert(plans[p].deck==deck);
+        total += plans[p].m;
+    }
+    assert(total<=max_matchups);
+    #pragma omp critical
+    total_comparisons += deck_boards(deck)*total;
+    if (do_nothing || !total)
+        return;
+    // Copy matchups to device
+    {timer_t timer("write matchups");
+    matchup_t* matchups = (matchup_t*)d.matchups[slot].begin_write(queue,total*sizeof(matchup_t));
+    for (size_t p = 0; p < count; p++)
+        matchups = std::copy(plans[p].matchups,plans[p].matchups+plans[p].m,matchups);
+    d.matchups[slot].end_write(queue,total*sizeof(matchup_t));}
+    // Compute all matchups in one launch and start reading back results
+    const size_t n = d.config.blocks(deck_boards(deck));
     {timer_t timer("compute");
-    d.queue.enqueueNDRangeKernel(d.compare_cards,cl::NullRange,cl::NDRange(n),cl::NullRange);
-    d.queue.finish();}
-    // Read back results and sum
-    vector<uint64_t> results(n);
-    {timer_t timer("read results");
-    d.queue.enqueueReadBuffer(d.results,CL_TRUE,0,sizeof(uint64_t)*n,&results[0]);}
-    uint64_t sum = 0;
-    for (size_t i = 0; i < n; i++)
-        sum += results[i];
-    // Fill in missing entries
-    {timer_t timer("missing");
-    for (size_t i = 0; i < NUM_FIVE_SUBSETS-n*BLOCK_SIZE; i++)
-        sum += compare_cards(alice_cards,bob_cards,free,five_subsets[n*BLOCK_SIZE+i]);}
-    return sum;
+    cl::Kernel& kernel = deck==SHORT_DECK?d.compare_short[slot]:d.compare_matchups[slot];
+    queue.enqueueNDRangeKernel(kernel,cl::NullRange,cl::NDRange(n,total),d.config.local(n,true));
+    d.results[slot].begin_read(queue,sizeof(uint64_t)*n*total,&d.done[slot]);
+    queue.flush();}
 }
 
-inline uint32_t bit_stack(bool b0, bool b1, bool b2, bool b3) {
-    return b0|b1<<1|b2<<2|b3<<3;
+// Wait for a slot started by compare_plans_start, and sum its results into outcomes.
+// If signatures is nonnull, it also receives the outcomes of each distinct matchup.
+void compare_plans_finish(size_t device, int slot, size_t count, const plan_t* plans, outcomes_t* outcomes, signatures_t* signatures=0) {
+    device_t& d = devices.at(device);
+    const size_t n = d.config.blocks(deck_boards(count?plans[0].deck:FULL_DECK));
+    const uint64_t* results = 0;
+    if (!do_nothing) {
+        timer_t timer("wait");
+        d.done[slot].wait();
+        results = (const uint64_t*)d.results[slot].host;
+    }
+    for (size_t p = 0, j = 0; p < count; p++) {
+        const plan_t& plan = plans[p];
+        outcomes_t& o = outcomes[p];
+        o = outcomes_t();
+        outcomes_t matchup[16];
+        for (int k = 0; k < plan.m; k++, j++) {
+            uint64_t sum = 1;
+            if (!do_nothing) {
+                sum = 0;
+                for (size_t i = 0; i < n; i++)
+                    sum += results[n*j+i];
+            }
+            o.add_wins(sum,plan.count[k]);
+            matchup[k].add_wins(sum);
+            matchup[k].tie = deck_boards(plan.deck)-matchup[k].alice-matchup[k].bob;
+        }
+        o.tie = plan.total-o.alice-o.bob;
+        if (signatures)
+            for (int sig = 0; sig < 16; sig++)
+                signatures[p].outcomes[sig] = plan.index[sig]<0?outcomes_t():matchup[plan.index[sig]];
+    }
+    if (!do_nothing)
+        d.results[slot].end_read(d.queues[slot]);
 }
 
-uint64_t total_comparisons = 0;
+// Omaha-8 outcomes: quarters[q] is the number of boards on which Alice gets q quarters of the pot
+struct split_outcomes_t {
+    uint64_t quarters[5];
 
-// Consider all possible sets of shared cards to determine the probabilities of wins, losses, and ties.
-// For efficiency, the set of shared cards is generated in decreasing order (this saves a factor of 5! = 120).
-outcomes_t compare_hands(size_t device, hand_t alice, hand_t bob) {
-    timer_t timer("compare hands");
-    uint32_t total = 0;
-    uint64_t wins = 0;
-    uint64_t cache[16] = {0}; // Cache wins based on 4 suit equality bits
-    // We fix the suits of Alice's cards
-    const int sa0 = 0, sa1 = !alice.suited;
-    const cards_t alice_cards = (cards_t(1)<<(alice.card0+13*sa0))|(cards_t(1)<<(alice.card1+13*sa1));
-    // Consider all compatible suits of Bob's cards
-    for (int sb0 = 0; sb0 < 4; sb0++)
-        for (int sb1 = 0; sb1 < 4; sb1++)
-            if ((sb0==sb1)==bob.suited) {
-                const cards_t bob_cards = (cards_t(1)<<(bob.card0+13*sb0))|(cards_t(1)<<(bob.card1+13*sb1));
-                const cards_t hand_cards = alice_cards|bob_cards;
-                // Make sure we don't use the same card twice
-                if (popcount(hand_cards)<4) continue;
-                // Did we already do this one?
-                int sig = bit_stack(sa0==sb0,sa0==sb1,sa1==sb0,sa1==sb1);
-                if (!cache[sig]) {
-                    // Make a list of the cards we're allowed to use
-                    cards_t free[48];
-                    for (int c = 0, i = 0; c < 52; c++)
-                        if (!((cards_t(1)<<c)&hand_cards))
-                            free[i++] = cards_t(1)<<c;
-                    // Consider all possible sets of shared cards
-                    cache[sig] = do_nothing?1:compare_cards_opencl(device, alice_cards, bob_cards, free);
-                    #pragma omp critical
-                    total_comparisons += NUM_FIVE_SUBSETS; 
-                }
-                wins += cache[sig];
-                total += NUM_FIVE_SUBSETS;
-            }
-    // Done
+    split_outcomes_t() {
+        memset(quarters,0,sizeof(quarters));
+    }
+
+    uint64_t total() const {
+        return quarters[0]+quarters[1]+quarters[2]+quarters[3]+quarters[4];
+    }
+
+    // Alice's share of all pots, in quarters
+    uint64_t alice() const {
+        return quarters[1]+2*quarters[2]+3*quarters[3]+4*quarters[4];
+    }
+};
+
+// Evaluate one Omaha matchup (four hole cards each) over all boards on one device, and return each block's result
+vector<uint64_t> omaha_blocks(size_t device, cl::Kernel device_t::*kernel, cards_t alice, cards_t bob) {
+    assert(popcount(alice)==4 && popcount(bob)==4 && !(alice&bob));
+    #pragma omp critical
+    total_comparisons += NUM_OMAHA_BOARDS;
+    if (do_nothing)
+        return vector<uint64_t>();
+    device_t& d = devices.at(device);
+    const cl::CommandQueue& queue = d.queues[0];
+    matchup_t* m = (matchup_t*)d.matchups[0].begin_write(queue,sizeof(matchup_t));
+    memset(m,0,sizeof(matchup_t));
+    m->alice_cards = alice;
+    m->bob_cards = bob;
+    for (int c = 0, j = 0; c < 52; c++)
+        if (!((cards_t(1)<<c)&(alice|bob)))
+            m->free[j++] = cards_t(1)<<c;
+    d.matchups[0].end_write(queue,sizeof(matchup_t));
+    const size_t n = d.config.blocks(NUM_OMAHA_BOARDS);
+    queue.enqueueNDRangeKernel(d.*kernel,cl::NullRange,cl::NDRange(n,1),d.config.local(n,true));
+    cl::Event event;
+    d.results[0].begin_read(queue,n*sizeof(uint64_t),&event);
+    event.wait();
+    const uint64_t* results = (const uint64_t*)d.results[0].host;
+    vector<uint64_t> blocks(results,results+n);
+    d.results[0].end_read(queue);
+    return blocks;
+}
+
+// Compare two Omaha hands over all boards on one device
+outcomes_t compare_omaha_opencl(size_t device, cards_t alice, cards_t bob) {
+    const vector<uint64_t> blocks = omaha_blocks(device,&device_t::compare_omaha,alice,bob);
     outcomes_t o;
-    o.alice = wins>>32;
-    o.bob = uint32_t(wins);
-    o.tie = total-o.alice-o.bob;
+    if (do_nothing)
+        return o;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < blocks.size(); i++)
+        sum += blocks[i];
+    o.add_wins(sum);
+    o.tie = NUM_OMAHA_BOARDS-o.alice-o.bob;
     return o;
 }
 
-void show_comparison(hand_t alice, hand_t bob,outcomes_t o) {
+// Compare two Omaha-8 hands over all boards on one device, unpacking the per block counters
+split_outcomes_t compare_omaha8_opencl(size_t device, cards_t alice, cards_t bob) {
+    const vector<uint64_t> blocks = omaha_blocks(device,&device_t::compare_omaha8,alice,bob);
+    split_outcomes_t o;
+    for (size_t i = 0; i < blocks.size(); i++)
+        for (int q = 0; q < 5; q++)
+            o.quarters[q] += blocks[i]>>(SPLIT_BITS*q)&((1<<SPLIT_BITS)-1);
+    return o;
+}
+
+void show_split(const char* alice, const char* bob, const split_outcomes_t& o) {
+    if (do_nothing) return;
+    const uint64_t total = o.total();
+    const char* names[5] = {"Bob scoops:    ","Bob gets 3/4:  ","Split:         ","Alice gets 3/4:","Alice scoops:  "};
+    cout<<alice<<" vs. "<<bob<<" (hi/lo):\n";
+    for (int q = 4; q >= 0; q--)
+        cout<<"  "<<names[q]<<' '<<o.quarters[q]<<"/"<<total<<" = "<<(double)o.quarters[q]/total<<'\n';
+    cout<<"  Alice equity:   "<<o.alice()<<"/"<<4*total<<" = "<<(double)o.alice()/(4*total)<<endl;
+}
+
+template<class H> void show_comparison(H alice, H bob, outcomes_t o) {
     if (do_nothing) return;
     cout<<alice<<" vs. "<<bob<<":\n"
           "  Alice: "<<o.alice<<"/"<<o.total()<<" = "<<(double)o.alice/o.total()
@@ -524,9 +954,15 @@ void test_score_hand() {
         cards[2*i+1] = bob|shared;
     }
 
-    // Score them
-    score_t scores[2*n];
+    // Score them, and make sure the host fallback in the batch library agrees
+    score_t scores[2*n], host_scores[2*n];
     score_hands_opencl(0,2*n,scores,cards);
+    score_batch_t::score_host(2*n,cards,host_scores);
+    for (size_t i = 0; i < 2*n; i++)
+        if (scores[i]!=host_scores[i]) {
+            cout<<"test "<<show_cards(cards[i])<<": opencl score "<<binary(scores[i])<<" != host score "<<binary(host_scores[i])<<endl;
+            exit(1);
+        }
 
     // Check results
     for (size_t i = 0; i < sizeof(tests)/sizeof(test_t); i++) {
@@ -544,6 +980,166 @@ void test_score_hand() {
     }
 }
 
+void test_score_low() {
+    const char *Alice = "Alice", *tie = "tie", *Bob = "Bob";
+    const score_batch_t::game_t A5 = score_batch_t::ACE_FIVE, D7 = score_batch_t::DEUCE_SEVEN;
+    struct test_t {
+        score_batch_t::game_t game;
+        const char *alice,*bob;
+        score_t alice_type,bob_type; // Types of the chosen five cards as high hands
+        const char* result;
+    };
+    const test_t tests[] = {
+        {A5,"Ah2d3c4h5s","Ac2h3d4s6c",HIGH_CARD,HIGH_CARD,Alice},           // the wheel is the best A-5 low
+        {A5,"Ah2h3h4h6h","Ad2d3d4d7c",HIGH_CARD,HIGH_CARD,Alice},           // flushes don't count in A-5
+        {A5,"Kh2d3c4h5s","Ac2c3d4s5d",HIGH_CARD,HIGH_CARD,Bob},             // aces are low in A-5
+        {A5,"2c2d3c4h5s","KcQdJhTs9c",PAIR,HIGH_CARD,Bob},                  // any five distinct ranks beat a pair
+        {A5,"2c2d3c3h5s","4c4d5c5h6s",TWO_PAIR,TWO_PAIR,Alice},             // the lower two pair wins
+        {A5,"Ah2d3c4h5sKdKc","6c2h3d4s5dAcAd",HIGH_CARD,HIGH_CARD,tie},     // only the best five of seven cards count
+        {A5,"2c2d2h3c3d4h4s","5c5d6h7s8cTcTd",TWO_PAIR,HIGH_CARD,Bob},      // pairs count only if there's no way around them
+        {A5,"9c9d9h9sKc","QcQdQhKdKh",QUADS,FULL_HOUSE,Bob},                // a full house beats quads in A-5
+        {D7,"7h5d4c3h2s","8c5h4d3s2d",HIGH_CARD,HIGH_CARD,Alice},           // 7-5-4-3-2 is the best 2-7 low
+        {D7,"Ah2d3c4h5s","8c6h4d3s2d",HIGH_CARD,HIGH_CARD,Bob},             // aces are high, so A-2-3-4-5 is not a straight
+        {D7,"6h5d4c3h2s","8c6h4d3s2d",STRAIGHT,HIGH_CARD,Bob},              // straights count against you in 2-7
+        {D7,"8h6h4h3h2h","9c7d5s3s2d",FLUSH,HIGH_CARD,Bob},                 // flushes count against you in 2-7
+        {D7,"2c2d3c4h5s","AcKdQhJs9c",PAIR,HIGH_CARD,Bob},                  // any five distinct ranks beat a pair
+    };
+    const size_t n = sizeof(tests)/sizeof(test_t);
+
+    for (size_t i = 0; i < n; i++) {
+        const test_t& t = tests[i];
+        cards_t cards[2] = {read_cards(t.alice),read_cards(t.bob)};
+        score_t scores[2], host_scores[2];
+        score_hands_opencl(0,2,scores,cards,t.game);
+        score_batch_t::score_host(2,cards,host_scores,t.game);
+        for (int j = 0; j < 2; j++)
+            if (scores[j]!=host_scores[j]) {
+                cout<<"low test "<<show_cards(cards[j])<<": opencl score "<<binary(scores[j])<<" != host score "<<binary(host_scores[j])<<endl;
+                exit(1);
+            }
+        const score_t alice_type = INVERT_SCORE(scores[0])&TYPE_MASK,
+                      bob_type   = INVERT_SCORE(scores[1])&TYPE_MASK;
+        const char* result = scores[0]>scores[1]?Alice:scores[0]<scores[1]?Bob:tie;
+        if (alice_type!=t.alice_type || bob_type!=t.bob_type || result!=t.result) {
+            cout<<"low test "<<t.alice<<' '<<t.bob
+                <<": expected "<<show_type(t.alice_type)<<' '<<show_type(t.bob_type)<<' '<<t.result
+                <<", got "<<show_type(alice_type)<<' '<<show_type(bob_type)<<' '<<result<<endl;
+            exit(1);
+        }
+    }
+}
+
+void test_score_omaha() {
+    const char *Alice = "Alice", *tie = "tie", *Bob = "Bob";
+    struct test_t {
+        const char *alice,*bob,*board;
+        score_t alice_type,bob_type;
+        const char* result;
+    };
+    const test_t tests[] = {
+        {"AsKsQsJs","7c7d2c3d","2s3s4h5h9d",HIGH_CARD,TWO_PAIR,Bob},   // four suited hole cards need three suited board cards
+        {"2c3d7h8h","2d3c7s8s","AhKhQhJhTh",FLUSH,HIGH_CARD,Alice},    // the board alone doesn't play
+        {"AsKd2c3d","AdQs2h3h","7c7d7h7s8c",TRIPS,TRIPS,Alice},        // only three board cards play, even with quads on the board
+        {"Ac8d3h5d","Ad7c3c5s","KhQs9h4c2s",HIGH_CARD,HIGH_CARD,Alice}, // the fifth card matters
+        {"AcKc2d3d","AdQd2h3h","KsQs5c4c9c",FLUSH,PAIR,Alice},         // two suited hole cards make a flush
+        {"Ah2h9c9d","As3s9h9s","4h5cKdQcJs",PAIR,PAIR,tie},            // a pair in the hole plays with three board kickers
+        {"QhJhTh9h","Kd8d7c6c","AhKhQcJc2s",STRAIGHT,PAIR,Alice},      // two hole cards and three board cards make a straight
+    };
+    for (size_t i = 0; i < sizeof(tests)/sizeof(test_t); i++) {
+        const cards_t alice = read_cards(tests[i].alice),
+                      bob   = read_cards(tests[i].bob),
+                      board = read_cards(tests[i].board);
+        if (popcount(alice|bob|board)!=13) {
+            cout<<"omaha test "<<tests[i].alice<<' '<<tests[i].bob<<' '<<tests[i].board<<" has duplicated cards"<<endl;
+            exit(1);
+        }
+        const score_t alice_score = score_omaha(alice,board),
+                      bob_score   = score_omaha(bob,board),
+                      alice_type  = alice_score&TYPE_MASK,
+                      bob_type    = bob_score&TYPE_MASK;
+        const char* result = alice_score>bob_score?Alice:alice_score<bob_score?Bob:tie;
+        if (alice_type!=tests[i].alice_type || bob_type!=tests[i].bob_type || result!=tests[i].result) {
+            cout<<"omaha test "<<tests[i].alice<<' '<<tests[i].bob<<' '<<tests[i].board
+                <<": expected "<<show_type(tests[i].alice_type)<<' '<<show_type(tests[i].bob_type)<<' '<<tests[i].result
+                <<", got "<<show_type(alice_type)<<' '<<show_type(bob_type)<<' '<<result<<endl;
+            exit(1);
+        }
+    }
+}
+
+void test_score_omaha8() {
+    struct test_t {
+        const char *alice,*bob,*board;
+        int quarters; // Alice's share of the pot in quarters
+    };
+    const test_t tests[] = {
+        {"As2s3dKd","AcAh4c5h","9h9cTcKcQs",0}, // no low without three board cards eight or lower
+        {"As2s3dKd","AcAh4c5h","6h7h8cKcQs",2}, // Alice's 8-7-6-2-A low splits with Bob's straight
+        {"As2sKhKd","Ac2c4c5h","3h7d8cKcQs",3}, // tied lows get quartered
+        {"Ah2hQcJc","Ad3dKsQs","4h5c6hTs9h",4}, // Alice scoops with a flush and the better low
+        {"2cKcKdQh","AdTcJhJd","3h4h5d6s9s",4}, // one low hole card can't make a low
+        {"2c2dKhKs","AdAcJhJd","3h4h5d9sTs",0}, // neither can a low pair in the hole
+        {"As3sKhKd","Ac2c8d8h","4h5d6cQsJs",2}, // the low compares from the top card down
+    };
+    for (size_t i = 0; i < sizeof(tests)/sizeof(test_t); i++) {
+        const cards_t alice = read_cards(tests[i].alice),
+                      bob   = read_cards(tests[i].bob),
+                      board = read_cards(tests[i].board);
+        if (popcount(alice|bob|board)!=13) {
+            cout<<"omaha8 test "<<tests[i].alice<<' '<<tests[i].bob<<' '<<tests[i].board<<" has duplicated cards"<<endl;
+            exit(1);
+        }
+        // Treat the whole board as the first free card so that compare_omaha8 sees it as subset 0
+        cards_t free[44] = {board};
+        const uint64_t packed = compare_omaha8(alice,bob,free,0);
+        int quarters = 0;
+        while (quarters<4 && !(packed>>SPLIT_BITS*quarters&1))
+            quarters++;
+        if (packed!=(uint64_t)1<<SPLIT_BITS*quarters || quarters!=tests[i].quarters) {
+            cout<<"omaha8 test "<<tests[i].alice<<' '<<tests[i].bob<<' '<<tests[i].board
+                <<": expected "<<tests[i].quarters<<" quarters for Alice, got "<<quarters<<endl;
+            exit(1);
+        }
+    }
+}
+
+void test_score_short() {
+    const char *Alice = "Alice", *tie = "tie", *Bob = "Bob";
+    struct test_t {
+        const char *alice,*bob,*shared;
+        score_t alice_type,bob_type;
+        const char* result;
+    };
+    const test_t tests[] = {
+        {"As6d","KsKc","7h8h9dQcJd",STRAIGHT,PAIR,Alice},                     // A-6-7-8-9 is a straight
+        {"As6d","Tc6c","7h8h9dKcKd",STRAIGHT,STRAIGHT,Bob},                   // A-6-7-8-9 is the lowest straight
+        {"AhKh","9s9c","QhJh9hQdQc",SHORT_FLUSH,SHORT_FULL_HOUSE,Alice},      // flush beats full house
+        {"AhKh","8s7c","ThJh9hQdQc",SHORT_FLUSH,STRAIGHT,Alice},              // flush still beats straight
+        {"6h7h","AsAc","8h9hThAhAd",STRAIGHT_FLUSH,QUADS,Alice},              // straight flush beats quads
+        {"Ah6h","KsKc","7h8h9hKdQc",STRAIGHT_FLUSH,TRIPS,Alice},              // aces can be low in straight flushes
+    };
+    for (size_t i = 0; i < sizeof(tests)/sizeof(test_t); i++) {
+        const cards_t alice  = read_cards(tests[i].alice),
+                      bob    = read_cards(tests[i].bob),
+                      shared = read_cards(tests[i].shared);
+        if (popcount(alice|bob|shared)!=9) {
+            cout<<"short deck test "<<tests[i].alice<<' '<<tests[i].bob<<' '<<tests[i].shared<<" has duplicated cards"<<endl;
+            exit(1);
+        }
+        const score_t alice_score = score_short_hand(alice|shared),
+                      bob_score   = score_short_hand(bob|shared),
+                      alice_type  = alice_score&TYPE_MASK,
+                      bob_type    = bob_score&TYPE_MASK;
+        const char* result = alice_score>bob_score?Alice:alice_score<bob_score?Bob:tie;
+        if (alice_type!=tests[i].alice_type || bob_type!=tests[i].bob_type || result!=tests[i].result) {
+            cout<<"short deck test "<<tests[i].alice<<' '<<tests[i].bob<<' '<<tests[i].shared
+                <<": expected "<<show_type(tests[i].alice_type,SHORT_DECK)<<' '<<show_type(tests[i].bob_type,SHORT_DECK)<<' '<<tests[i].result
+                <<", got "<<show_type(alice_type,SHORT_DECK)<<' '<<show_type(bob_type,SHORT_DECK)<<' '<<result<<endl;
+            exit(1);
+        }
+    }
+}
+
 inline cards_t mostly_random_set(uint64_t r) {
     cards_t cards = 0;
     #define ADD(a) \
@@ -581,8 +1177,8 @@ void regression_test_score_hand(size_t multiple) {
         cout<<"score test passed!"<<endl;
 }
 
-// List of all possible two card hands
-vector<hand_t> hands;
+// List of all possible two card hands, and the subset without 2s through 5s for short deck
+vector<hand_t> hands, short_hands;
 
 void compute_hands() {
     for (int c0 = 0; c0 < 13; c0++) {
@@ -592,69 +1188,765 @@ void compute_hands() {
                 hands.push_back(hand_t(c0,c1,s));
     }
     assert(hands.size()==169);
+    for (size_t i = 0; i < hands.size(); i++)
+        if (hands[i].card1>=4)
+            short_hands.push_back(hands[i]);
+    assert(short_hands.size()==81);
 }
 
-vector<outcomes_t> compare_many_hands(const vector<hand_t>& pairs, bool verbose) {
+// Compare pairs of hands stored consecutively in pairs.  If signatures is nonnull, it receives per signature outcomes.
+vector<outcomes_t> compare_many_hands(const vector<hand_t>& pairs, bool verbose, deck_t deck=FULL_DECK, vector<signatures_t>* signatures=0) {
     assert(pairs.size()%2==0);
     size_t n = pairs.size()/2;
     size_t next = 0, show = 0;
     vector<outcomes_t> outcomes(n);
+    if (signatures)
+        signatures->resize(n);
     #pragma omp parallel num_threads(devices.size()) 
     {
         size_t device = omp_get_thread_num();
-        for (;;) {
-            // Grab next free job
-            size_t job;
+        // Jobs are grabbed in batches, each evaluated in one kernel launch.  Consecutive batches alternate slots,
+        // so that one batch's transfers and host work overlap with the next batch's kernel.
+        size_t first[2] = {0,0}, count[2] = {0,0};
+        plan_t plans[2][hands_per_launch];
+        for (int slot = 0;; slot ^= 1) {
+            // Grab next batch of free jobs
             #pragma omp critical 
-            job = next++;
-            if (job>=n) break;
-            // Compute
-            outcomes_t o = compare_hands(device,pairs[2*job],pairs[2*job+1]);
-            // Store results and optionally print
-            #pragma omp critical
             {
-                outcomes[job] = o;
-                while (show<n && outcomes[show].total()) {
-                    if (verbose)
-                        show_comparison(pairs[2*show],pairs[2*show+1],outcomes[show]);
-                    else
-                        cout<<(show?", ":"")<<pairs[2*show]<<" vs. "<<pairs[2*show+1]<<flush;
-                    show++;
+                first[slot] = next;
+                count[slot] = min(hands_per_launch,n-min(n,next));
+                next += count[slot];
+            }
+            // Start computing
+            {timer_t timer("compare hands");
+            for (size_t j = 0; j < count[slot]; j++)
+                plan_hands(pairs[2*(first[slot]+j)],pairs[2*(first[slot]+j)+1],plans[slot][j],deck);
+            compare_plans_start(device,slot,count[slot],plans[slot]);}
+            // Finish the previous batch
+            const int prev = slot^1;
+            if (count[prev]) {
+                vector<outcomes_t> o(count[prev]);
+                vector<signatures_t> sigs(signatures?count[prev]:0);
+                {timer_t timer("compare hands");
+                compare_plans_finish(device,prev,count[prev],plans[prev],&o[0],signatures?&sigs[0]:0);}
+                // Store results and optionally print
+                #pragma omp critical
+                {
+                    std::copy(o.begin(),o.end(),outcomes.begin()+first[prev]);
+                    if (signatures)
+                        std::copy(sigs.begin(),sigs.end(),signatures->begin()+first[prev]);
+                    while (show<n && outcomes[show].total()) {
+                        if (verbose)
+                            show_comparison(pairs[2*show],pairs[2*show+1],outcomes[show]);
+                        else
+                            cout<<(show?", ":"")<<pairs[2*show]<<" vs. "<<pairs[2*show+1]<<flush;
+                        show++;
+                    }
                 }
+                count[prev] = 0;
             }
+            if (!count[slot]) break;
         }
     }
     return outcomes;
 }
 
-void regression_test_compare_hands(size_t n) {
+void regression_test_compare_hands(size_t n, deck_t deck=FULL_DECK) {
     timer_t timer("test compare hands");
-    cout<<"compare test: comparing "<<n<<" random pairs of hands, including at least one matched pair"<<endl;
+    const char* name = deck==SHORT_DECK?"short deck test":"compare test";
+    const vector<hand_t>& pool = deck==SHORT_DECK?short_hands:hands;
+    cout<<name<<": comparing "<<n<<" random pairs of hands, including at least one matched pair"<<endl;
     vector<hand_t> pairs;
     for (uint64_t i = 0; i <= n; i++) {
-        hand_t alice =   hands[hash2(i,0)%hands.size()],
-               bob   = i?hands[hash2(i,1)%hands.size()]:alice;
+        hand_t alice =   pool[hash2(i,0)%pool.size()],
+               bob   = i?pool[hash2(i,1)%pool.size()]:alice;
         pairs.push_back(alice);
         pairs.push_back(bob);
     }
-    vector<outcomes_t> outcomes = compare_many_hands(pairs,false);
+    vector<outcomes_t> outcomes = compare_many_hands(pairs,false,deck);
     uint64_t signature = 0;
     for (uint64_t i = 0; i <= n; i++) {
         outcomes_t o = outcomes[i];
         signature = hash2(signature,hash3(o.alice,o.bob,o.tie));
     }
     cout<<endl;
-    const uint64_t expected = n==1 ?0xb034c27133337c71:
-                              n==2 ?0x80e493c487b72627:
-                              n==10?0x006c9a21c45a67b5:0;
+    const uint64_t expected = deck==FULL_DECK ? (n==1 ?0xb034c27133337c71:
+                                                 n==2 ?0x80e493c487b72627:
+                                                 n==10?0x006c9a21c45a67b5:0)
+                                              : (n==1 ?0xdea7da950ce65b66:
+                                                 n==2 ?0x70ca5c55c5d79a23:
+                                                 n==10?0xeade1f327347e409:0);
     if (signature!=expected) {
         if (expected) {
-            cout<<"compare test: expected 0x"<<std::hex<<expected<<", got 0x"<<signature<<std::dec<<endl;
+            cout<<name<<": expected 0x"<<std::hex<<expected<<", got 0x"<<signature<<std::dec<<endl;
             exit(1);
         } else
-            cout<<"compare test: expected value for n = "<<n<<std::hex<<" not known, got 0x"<<signature<<std::dec<<endl;
+            cout<<name<<": expected value for n = "<<n<<std::hex<<" not known, got 0x"<<signature<<std::dec<<endl;
     } else
-        cout<<"compare test passed!"<<endl;
+        cout<<name<<" passed!"<<endl;
+}
+
+// Compare pairs of Omaha hands stored consecutively in pairs, spreading them over all devices
+template<class O> vector<O> compare_omaha_hands(const vector<cards_t>& pairs, O (*compare)(size_t,cards_t,cards_t)) {
+    assert(pairs.size()%2==0);
+    const size_t n = pairs.size()/2;
+    size_t next = 0;
+    vector<O> outcomes(n);
+    #pragma omp parallel num_threads(devices.size())
+    {
+        const size_t device = omp_get_thread_num();
+        for (;;) {
+            size_t job;
+            #pragma omp critical
+            job = next++;
+            if (job>=n) break;
+            timer_t timer("compare omaha");
+            outcomes[job] = compare(device,pairs[2*job],pairs[2*job+1]);
+        }
+    }
+    return outcomes;
+}
+
+void regression_test_compare_omaha() {
+    timer_t timer("test compare omaha");
+    cout<<"omaha test: comparing AsAhKsKh vs. QcQdJcJd and AsKsQdJd vs. 9h9c8h7c"<<endl;
+    vector<cards_t> pairs;
+    pairs.push_back(read_cards("AsAhKsKh"));
+    pairs.push_back(read_cards("QcQdJcJd"));
+    pairs.push_back(read_cards("AsKsQdJd"));
+    pairs.push_back(read_cards("9h9c8h7c"));
+    const vector<outcomes_t> outcomes = compare_omaha_hands(pairs,compare_omaha_opencl);
+    const uint64_t expected[2][3] = {{688294,397666,48},{572912,513096,0}};
+    for (int i = 0; i < 2; i++) {
+        const outcomes_t& o = outcomes[i];
+        if (o.alice!=expected[i][0] || o.bob!=expected[i][1] || o.tie!=expected[i][2]) {
+            cout<<"omaha test: expected "<<expected[i][0]<<' '<<expected[i][1]<<' '<<expected[i][2]
+                <<", got "<<o.alice<<' '<<o.bob<<' '<<o.tie<<endl;
+            exit(1);
+        }
+    }
+    cout<<"omaha test passed!"<<endl;
+}
+
+void regression_test_compare_omaha8() {
+    timer_t timer("test compare omaha8");
+    cout<<"omaha8 test: comparing As2s3dKd vs. AcAh4c5h and AsAhKsKh vs. QcQdJcJd"<<endl;
+    vector<cards_t> pairs;
+    pairs.push_back(read_cards("As2s3dKd"));
+    pairs.push_back(read_cards("AcAh4c5h"));
+    pairs.push_back(read_cards("AsAhKsKh"));
+    pairs.push_back(read_cards("QcQdJcJd"));
+    const vector<split_outcomes_t> outcomes = compare_omaha_hands(pairs,compare_omaha8_opencl);
+    const uint64_t expected[2][5] = {{429240,654,332510,630,322974},{397666,0,48,0,688294}};
+    for (int i = 0; i < 2; i++)
+        for (int q = 0; q <= 4; q++)
+            if (outcomes[i].quarters[q]!=expected[i][q]) {
+                cout<<"omaha8 test: expected "<<expected[i][q]<<" boards giving Alice "<<q<<" quarters, got "<<outcomes[i].quarters[q]<<endl;
+                exit(1);
+            }
+    cout<<"omaha8 test passed!"<<endl;
+}
+
+// All pairs of hands (hands[i],hands[j]) with j <= i, so that pair (i,j) is at index i*(i+1)/2+j
+vector<hand_t> all_pairs(const vector<hand_t>& pool=hands) {
+    vector<hand_t> pairs;
+    for (size_t i = 0; i < pool.size(); i++)
+        for (size_t j = 0; j <= i; j++) {
+            pairs.push_back(pool[i]);
+            pairs.push_back(pool[j]);
+        }
+    return pairs;
+}
+
+// Two card combos are indexed by their cards c0 > c1 (numbered rank+13*suit as in cards_t) as c0*(c0-1)/2+c1
+const int num_combos = 52*51/2;
+
+struct combo_t {
+    cards_t cards;
+    int hand; // Index into hands
+    int suit0, suit1; // Suits of the higher and lower card
+};
+
+// Expand per signature outcomes of all_pairs into a dense table of combo matchups, and write it as a raw
+// little endian uint32 array of shape (num_combos,num_combos,3) holding Alice's wins, Bob's wins, and ties.
+// The file is meant to be mmapped directly.  Combo matchups which share a card are all zero.
+void write_combos(const char* path, const vector<outcomes_t>& outcomes, const vector<signatures_t>& signatures) {
+    timer_t timer("write combos");
+    int hand_index[13][13][2];
+    for (size_t i = 0; i < hands.size(); i++)
+        hand_index[hands[i].card0][hands[i].card1][hands[i].suited] = i;
+    vector<combo_t> combos;
+    for (int c0 = 0; c0 < 52; c0++)
+        for (int c1 = 0; c1 < c0; c1++) {
+            int r0 = c0%13, s0 = c0/13, r1 = c1%13, s1 = c1/13;
+            if (r0<r1) {
+                std::swap(r0,r1);
+                std::swap(s0,s1);
+            }
+            combo_t c = {cards_t(1)<<c0|cards_t(1)<<c1,hand_index[r0][r1][s0==s1],s0,s1};
+            combos.push_back(c);
+        }
+    assert(combos.size()==size_t(num_combos));
+
+    // Suit signatures are invariant under suit permutation, so each combo matchup is one of the signatures of its
+    // pair of hands.  Pairs of hands are only stored in one order, so we swap Alice and Bob if necessary.
+    vector<uint32_t> table(3*num_combos*num_combos);
+    vector<outcomes_t> sums(outcomes.size());
+    for (int a = 0; a < num_combos; a++)
+        for (int b = 0; b < num_combos; b++) {
+            const combo_t &A = combos[a], &B = combos[b];
+            if (A.cards&B.cards) continue;
+            const bool swap = A.hand<B.hand;
+            const combo_t &x = swap?B:A, &y = swap?A:B;
+            const size_t pair = x.hand*(x.hand+1)/2+y.hand;
+            const outcomes_t& o = signatures[pair].outcomes[bit_stack(x.suit0==y.suit0,x.suit0==y.suit1,x.suit1==y.suit0,x.suit1==y.suit1)];
+            if (o.total()!=NUM_FIVE_SUBSETS) {
+                cerr<<"combos: missing signature for "<<show_cards(A.cards)<<" vs. "<<show_cards(B.cards)<<endl;
+                exit(1);
+            }
+            uint32_t* t = &table[3*(num_combos*a+b)];
+            t[0] = swap?o.bob:o.alice;
+            t[1] = swap?o.alice:o.bob;
+            t[2] = o.tie;
+            if (!swap)
+                sums[pair] += o;
+        }
+
+    // Summing over Alice's combos should give a multiple of the outcomes for each pair of hands.
+    // plan_hands counts both orders of Bob's cards if he has a pair, so we double those sums.
+    for (size_t i = 0; i < hands.size(); i++)
+        for (size_t j = 0; j <= i; j++) {
+            const size_t pair = i*(i+1)/2+j;
+            const uint64_t m = hands[i].card0==hands[i].card1?6:hands[i].suited?4:12,
+                           b = hands[j].card0==hands[j].card1?2:1;
+            const outcomes_t &s = sums[pair], &o = outcomes[pair];
+            if (b*s.alice!=m*o.alice || b*s.bob!=m*o.bob || b*s.tie!=m*o.tie) {
+                cerr<<"combos: inconsistent totals for "<<hands[i]<<" vs. "<<hands[j]<<endl;
+                exit(1);
+            }
+        }
+
+    FILE* file = fopen(path,"wb");
+    if (!file || fwrite(&table[0],sizeof(uint32_t),table.size(),file)!=table.size() || fclose(file)) {
+        cerr<<"combos: failed to write \""<<path<<"\""<<endl;
+        exit(1);
+    }
+    cout<<"wrote "<<num_combos<<"x"<<num_combos<<" combo table to "<<path<<endl;
+}
+
+// Apply a permutation of the four suits to a set of cards
+inline cards_t permute_suits(cards_t cards, const int* perm) {
+    cards_t r = 0;
+    for (int s = 0; s < 4; s++)
+        r |= (cards>>13*s&0x1fff)<<13*perm[s];
+    return r;
+}
+
+// The next larger set with the same number of cards (Gosper's hack)
+inline cards_t next_subset(cards_t cards) {
+    const cards_t low = cards&-cards, ripple = cards+low;
+    return ripple|((cards^ripple)>>2)/low;
+}
+
+// All boards of n cards up to suit permutation, each paired with the number of boards it represents
+vector<pair<cards_t,uint32_t> > canonical_boards(int n) {
+    timer_t timer("canonical boards");
+    int perms[24][4], p[4] = {0,1,2,3}, count = 0;
+    do memcpy(perms[count++],p,sizeof(p));
+    while (std::next_permutation(p,p+4));
+    unordered_map<cards_t,uint32_t> counts;
+    for (cards_t board = (cards_t(1)<<n)-1; board < cards_t(1)<<52;) {
+        cards_t least = board;
+        for (int i = 1; i < 24; i++)
+            least = min(least,permute_suits(board,perms[i]));
+        counts[least]++;
+        board = next_subset(board);
+    }
+    vector<pair<cards_t,uint32_t> > boards(counts.begin(),counts.end());
+    sort(boards.begin(),boards.end());
+    return boards;
+}
+
+// Holdings available once five board cards are dealt, and the opponent holdings disjoint from each one
+const int num_holdings = 47*46/2, num_opponents = 45*44/2;
+
+// Write each holding which avoids a five card board, together with the board, to cards
+void board_holdings(cards_t board, cards_t* cards) {
+    for (int c0 = 0; c0 < 52; c0++)
+        for (int c1 = 0; c1 < c0; c1++) {
+            const cards_t holding = cards_t(1)<<c0|cards_t(1)<<c1;
+            if (!(board&holding))
+                *cards++ = board|holding;
+        }
+}
+
+// Given the scores of all holdings on a five card board (in board_holdings order), count each holding's wins and
+// ties against the opponent holdings which avoid its cards.  After sorting by score, a holding beats every lower
+// holding except those sharing one of its two cards, and per card counts of lower and equal holdings take care of
+// card removal.  order is scratch space with num_holdings entries.
+void count_board(const score_t* scores, uint32_t* wins, uint32_t* ties, pair<score_t,int>* order) {
+    // Number the 47 cards off the board in order, and replay board_holdings to recover each holding's cards
+    int cards[num_holdings][2];
+    for (int c0 = 0, h = 0; c0 < 47; c0++)
+        for (int c1 = 0; c1 < c0; c1++, h++) {
+            cards[h][0] = c0;
+            cards[h][1] = c1;
+        }
+    for (int h = 0; h < num_holdings; h++)
+        order[h] = make_pair(scores[h],h);
+    sort(order,order+num_holdings);
+    uint32_t lower[47] = {0}, equal[47] = {0}, total_lower = 0;
+    for (int i = 0; i < num_holdings;) {
+        int j = i;
+        while (j<num_holdings && order[j].first==order[i].first)
+            j++;
+        for (int k = i; k < j; k++) {
+            const int* c = cards[order[k].second];
+            equal[c[0]]++;
+            equal[c[1]]++;
+        }
+        for (int k = i; k < j; k++) {
+            const int h = order[k].second, *c = cards[h];
+            // Inclusion-exclusion: only this holding itself contains both cards
+            wins[h] = total_lower-lower[c[0]]-lower[c[1]];
+            ties[h] = j-i-equal[c[0]]-equal[c[1]]+1;
+        }
+        for (int k = i; k < j; k++) {
+            const int* c = cards[order[k].second];
+            equal[c[0]] = equal[c[1]] = 0;
+            lower[c[0]]++;
+            lower[c[1]]++;
+        }
+        total_lower += j-i;
+        i = j;
+    }
+}
+
+// Index into hands of a holding
+struct hand_index_t {
+    int index[13][13][2];
+
+    hand_index_t() {
+        for (size_t i = 0; i < hands.size(); i++)
+            index[hands[i].card0][hands[i].card1][hands[i].suited] = i;
+    }
+
+    int operator()(cards_t holding) const {
+        const int c0 = __builtin_ctzll(holding), c1 = 63-__builtin_clzll(holding),
+                  r0 = c0%13, r1 = c1%13;
+        return index[max(r0,r1)][min(r0,r1)][c0/13==c1/13];
+    }
+};
+
+// Exact outcomes of each hand against a uniformly random opponent.  Rather than enumerating matchups, we score every
+// holding on every board up to suit permutation on the device, and count card removal aware outcomes on the host.
+vector<outcomes_t> compare_random_hands() {
+    const vector<pair<cards_t,uint32_t> > boards = canonical_boards(5);
+    const hand_index_t hand_index;
+    const size_t batch = max_cards/num_holdings;
+    size_t next = 0;
+    vector<outcomes_t> outcomes(hands.size());
+    cout<<"random: scoring "<<boards.size()<<" boards"<<flush;
+    #pragma omp parallel num_threads(devices.size())
+    {
+        const size_t device = omp_get_thread_num();
+        vector<cards_t> cards(batch*num_holdings);
+        vector<score_t> scores(batch*num_holdings);
+        vector<uint32_t> wins(num_holdings), ties(num_holdings);
+        vector<pair<score_t,int> > order(num_holdings);
+        vector<outcomes_t> sums(hands.size());
+        for (;;) {
+            size_t first, count;
+            #pragma omp critical
+            {
+                first = next;
+                count = min(batch,boards.size()-min(boards.size(),next));
+                next += count;
+            }
+            if (!count) break;
+            if (do_nothing) continue;
+            for (size_t b = 0; b < count; b++)
+                board_holdings(boards[first+b].first,&cards[b*num_holdings]);
+            {timer_t timer("score random");
+            score_hands_opencl(device,count*num_holdings,&scores[0],&cards[0]);}
+            timer_t timer("count random");
+            for (size_t b = 0; b < count; b++) {
+                const cards_t board = boards[first+b].first;
+                const uint64_t weight = boards[first+b].second;
+                count_board(&scores[b*num_holdings],&wins[0],&ties[0],&order[0]);
+                for (int h = 0; h < num_holdings; h++) {
+                    outcomes_t o;
+                    o.alice = weight*wins[h];
+                    o.tie = weight*ties[h];
+                    o.bob = weight*num_opponents-o.alice-o.tie;
+                    sums[hand_index(cards[b*num_holdings+h]&~board)] += o;
+                }
+            }
+            #pragma omp critical
+            cout<<'.'<<flush;
+        }
+        #pragma omp critical
+        for (size_t i = 0; i < hands.size(); i++)
+            outcomes[i] += sums[i];
+    }
+    cout<<endl;
+    return outcomes;
+}
+
+// Run every street board (street is the number of board cards: 3, 4, or 5) up to suit permutation out to five cards,
+// scoring holdings as in compare_random_hands, and pass each combo's wins and ties vs. a random hand summed over
+// runouts to visitor(board,weight,wins,ties), where wins and ties are indexed by combo.  Street boards are grabbed in
+// batches as in compare_many_hands.  Each device thread visits with its own copy of visitor, which is then merged
+// into visitor with visitor.merge.
+template<class V> void street_equities(int street, V& visitor) {
+    assert(3<=street && street<=5);
+    const vector<pair<cards_t,uint32_t> > boards = canonical_boards(street);
+    const int runouts = street==3?49*48/2:street==4?48:1;
+    const size_t batch = max_cards/num_holdings/runouts;
+    size_t next = 0;
+    cout<<"running out "<<boards.size()<<(street==3?" flops":street==4?" turns":" rivers")<<flush;
+    #pragma omp parallel num_threads(devices.size())
+    {
+        const size_t device = omp_get_thread_num();
+        V local(visitor);
+        vector<cards_t> cards(batch*runouts*num_holdings), runout_boards(batch*runouts);
+        vector<score_t> scores(cards.size());
+        vector<uint32_t> wins(num_holdings), ties(num_holdings);
+        vector<pair<score_t,int> > order(num_holdings);
+        vector<uint64_t> combo_wins(num_combos), combo_ties(num_combos);
+        for (;;) {
+            size_t first, count;
+            #pragma omp critical
+            {
+                first = next;
+                count = min(batch,boards.size()-min(boards.size(),next));
+                next += count;
+            }
+            if (!count) break;
+            if (do_nothing) continue;
+            for (size_t b = 0; b < count; b++) {
+                const cards_t board = boards[first+b].first;
+                cards_t* r = &runout_boards[b*runouts];
+                if (street==5)
+                    *r++ = board;
+                else
+                    for (cards_t runout = (cards_t(1)<<(5-street))-1; runout < cards_t(1)<<52; runout = next_subset(runout))
+                        if (!(board&runout))
+                            *r++ = board|runout;
+                assert(r==&runout_boards[(b+1)*runouts]);
+            }
+            for (size_t r = 0; r < count*runouts; r++)
+                board_holdings(runout_boards[r],&cards[r*num_holdings]);
+            {timer_t timer("score runouts");
+            score_hands_opencl(device,count*runouts*num_holdings,&scores[0],&cards[0]);}
+            timer_t timer("count runouts");
+            for (size_t b = 0; b < count; b++) {
+                std::fill(combo_wins.begin(),combo_wins.end(),0);
+                std::fill(combo_ties.begin(),combo_ties.end(),0);
+                for (int r = 0; r < runouts; r++) {
+                    const size_t offset = (b*runouts+r)*num_holdings;
+                    count_board(&scores[offset],&wins[0],&ties[0],&order[0]);
+                    for (int h = 0; h < num_holdings; h++) {
+                        const cards_t holding = cards[offset+h]&~runout_boards[b*runouts+r];
+                        const int c0 = 63-__builtin_clzll(holding), c1 = __builtin_ctzll(holding);
+                        combo_wins[c0*(c0-1)/2+c1] += wins[h];
+                        combo_ties[c0*(c0-1)/2+c1] += ties[h];
+                    }
+                }
+                local(boards[first+b].first,boards[first+b].second,&combo_wins[0],&combo_ties[0]);
+            }
+            #pragma omp critical
+            cout<<'.'<<flush;
+        }
+        #pragma omp critical
+        visitor.merge(local);
+    }
+    cout<<endl;
+}
+
+// Bins each combo's equity on each street board, and optionally sums outcomes by hand
+struct histogram_visitor_t {
+    const hand_index_t hand_index;
+    const int bins;
+    const uint64_t total; // Opponent holdings and runouts which avoid a given combo
+    vector<uint32_t> histograms;
+    vector<outcomes_t> sums;
+
+    histogram_visitor_t(int street, int bins, bool sum)
+        :bins(bins),total((street==3?47*46/2:46)*num_opponents),histograms(hands.size()*bins),sums(sum?hands.size():0) {}
+
+    void operator()(cards_t board, uint32_t weight, const uint64_t* wins, const uint64_t* ties) {
+        for (int c0 = 0; c0 < 52; c0++)
+            for (int c1 = 0; c1 < c0; c1++) {
+                const cards_t holding = cards_t(1)<<c0|cards_t(1)<<c1;
+                if (board&holding) continue;
+                const int combo = c0*(c0-1)/2+c1, hand = hand_index(holding);
+                // Bin exactly using integer arithmetic, putting equity 1 in the last bin
+                const int bin = min<uint64_t>(bins-1,(2*wins[combo]+ties[combo])*bins/(2*total));
+                histograms[hand*bins+bin] += weight;
+                if (sums.size()) {
+                    outcomes_t o;
+                    o.alice = weight*wins[combo];
+                    o.tie = weight*ties[combo];
+                    o.bob = weight*total-o.alice-o.tie;
+                    sums[hand] += o;
+                }
+            }
+    }
+
+    void merge(const histogram_visitor_t& v) {
+        for (size_t i = 0; i < histograms.size(); i++)
+            histograms[i] += v.histograms[i];
+        for (size_t i = 0; i < sums.size(); i++)
+            sums[i] += v.sums[i];
+    }
+};
+
+// Distributions of equity vs. a random hand for card abstraction.  For each hand, entry (hand,bin) of the result counts
+// pairs of a combo of the hand and a street board (a flop if street is 3, or a turn if 4) on which the combo's equity
+// lies in [bin/bins,(bin+1)/bins).  If sums is nonnull, it receives outcome counts summed over all street boards,
+// which are a multiple of compare_random_hands.
+vector<uint32_t> equity_histograms(int street, int bins, vector<outcomes_t>* sums=0) {
+    assert(street==3 || street==4);
+    histogram_visitor_t visitor(street,bins,sums!=0);
+    cout<<"histogram: ";
+    street_equities(street,visitor);
+    if (sums)
+        sums->swap(visitor.sums);
+    return visitor.histograms;
+}
+
+// Write histograms from equity_histograms as a raw little endian uint32 array of shape (hands,bins), meant to be mmapped
+void write_histograms(const char* path, const vector<uint32_t>& histograms) {
+    FILE* file = fopen(path,"wb");
+    if (!file || fwrite(&histograms[0],sizeof(uint32_t),histograms.size(),file)!=histograms.size() || fclose(file)) {
+        cerr<<"histogram: failed to write \""<<path<<"\""<<endl;
+        exit(1);
+    }
+    cout<<"wrote "<<hands.size()<<"x"<<histograms.size()/hands.size()<<" equity histograms to "<<path<<endl;
+}
+
+// Stores each combo's equity on each board into a mapped equity table.  Isomorphic hands always come from the same
+// canonical board, so threads never write the same entry.
+struct table_visitor_t {
+    const hand_indexer_t indexer;
+    const equity_table_header_t& header;
+    void* data;
+
+    table_visitor_t(const equity_table_header_t& header, void* data)
+        :indexer(2,cards_per_round(header.board)),header(header),data(data) {}
+
+    static const int* cards_per_round(int board) {
+        static const int turn[2] = {2,4}, river[2] = {2,5};
+        return board==4?turn:river;
+    }
+
+    void operator()(cards_t board, uint32_t weight, const uint64_t* wins, const uint64_t* ties) {
+        for (int c0 = 0; c0 < 52; c0++)
+            for (int c1 = 0; c1 < c0; c1++) {
+                const cards_t cards[2] = {cards_t(1)<<c0|cards_t(1)<<c1,board};
+                if (cards[0]&board) continue;
+                const int combo = c0*(c0-1)/2+c1;
+                const uint64_t i = indexer.index(cards), entry = 2*wins[combo]+ties[combo];
+                assert(entry<=header.scale);
+                if (header.bytes==2)
+                    ((uint16_t*)data)[i] = entry;
+                else
+                    ((uint32_t*)data)[i] = entry;
+            }
+    }
+
+    void merge(const table_visitor_t& v) {}
+};
+
+// Build the turn or river equity table (board is 4 or 5) and write it to path.  Entries are streamed into a mapped
+// file as each board finishes, and the header goes in last so that an interrupted build leaves an invalid table.
+void write_equity_table(const char* path, int board) {
+    const equity_table_header_t header = equity_table_header_t::make(board);
+    const size_t length = sizeof(header)+header.bytes*header.size;
+    // With --nop nothing is scored and the visitor is never called, so run the boards without touching path
+    if (do_nothing) {
+        table_visitor_t visitor(header,0);
+        cout<<"table: ";
+        street_equities(board,visitor);
+        return;
+    }
+    const int fd = open(path,O_RDWR|O_CREAT|O_TRUNC,0644);
+    void* p = fd>=0 && !ftruncate(fd,length)?mmap(0,length,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0):MAP_FAILED;
+    if (fd>=0)
+        close(fd);
+    if (p==MAP_FAILED) {
+        cerr<<"table: failed to create \""<<path<<"\""<<endl;
+        exit(1);
+    }
+    table_visitor_t visitor(header,(equity_table_header_t*)p+1);
+    cout<<"table: ";
+    street_equities(board,visitor);
+    memcpy(p,&header,sizeof(header));
+    if (msync(p,length,MS_SYNC) || munmap(p,length)) {
+        cerr<<"table: failed to write \""<<path<<"\""<<endl;
+        exit(1);
+    }
+    cout<<"wrote "<<header.size<<(board==4?" turn":" river")<<" equities to "<<path<<endl;
+}
+
+// Check random entries of an equity table against direct enumeration on the host
+void check_equity_table(const char* path, int samples) {
+    timer_t timer("check table");
+    const equity_table_t table(path);
+    if (!table.valid())
+        exit(1);
+    for (int t = 0; t < samples; t++) {
+        cards_t hole = 0, board = 0;
+        for (int n = 0; popcount(hole)<2 || popcount(board)<uint64_t(table.board()); n++) {
+            const cards_t card = cards_t(1)<<hash3(table.board(),t,n)%52;
+            if ((hole|board)&card) continue;
+            if (popcount(hole)<2)
+                hole |= card;
+            else
+                board |= card;
+        }
+        uint64_t entry = 0;
+        const bool turn = table.board()==4;
+        for (int r = 0; r < (turn?52:1); r++) {
+            const cards_t river = turn?cards_t(1)<<r:0;
+            if ((hole|board)&river) continue;
+            const cards_t full = board|river;
+            const score_t score = score_hand(hole|full);
+            for (int c0 = 0; c0 < 52; c0++)
+                for (int c1 = 0; c1 < c0; c1++) {
+                    const cards_t opponent = cards_t(1)<<c0|cards_t(1)<<c1;
+                    if (opponent&(hole|full)) continue;
+                    const score_t other = score_hand(opponent|full);
+                    entry += score>other?2:score==other;
+                }
+        }
+        if (table.entry(hole,board)!=entry) {
+            cout<<"table: "<<show_cards(hole)<<' '<<show_cards(board)<<" has entry "<<table.entry(hole,board)<<", expected "<<entry<<endl;
+            exit(1);
+        }
+    }
+    cout<<"table: "<<samples<<" random entries match direct enumeration"<<endl;
+}
+
+void test_hand_index() {
+    // Hold'em streets have the sizes given by Waugh
+    const uint64_t sizes[4] = {169,1286792,55190538,2428287420ULL};
+    const int cards_per_round[4] = {2,3,1,1};
+    for (int street = 0; street < 4; street++) {
+        const hand_indexer_t indexer = hand_indexer_t::holdem(street);
+        if (indexer.size()!=sizes[street]) {
+            cout<<"hand index test: expected "<<sizes[street]<<" hands on street "<<street<<", got "<<indexer.size()<<endl;
+            exit(1);
+        }
+        // Indices of random hands are invariant under suit permutation, and canonical hands round trip
+        for (int t = 0; t < 256; t++) {
+            cards_t cards[4], permuted[4], canonical[4], used = 0;
+            int perm[4] = {0,1,2,3};
+            for (int s = 3; s > 0; s--)
+                std::swap(perm[s],perm[hash3(street,t,s)%(s+1)]);
+            for (int i = 0, n = 0; i <= street; i++) {
+                cards[i] = 0;
+                for (int j = 0; j < cards_per_round[i]; n++) {
+                    const cards_t card = cards_t(1)<<hash3(street,t,4+n)%52;
+                    if (!(used&card)) {
+                        cards[i] |= card;
+                        used |= card;
+                        j++;
+                    }
+                }
+                permuted[i] = permute_suits(cards[i],perm);
+            }
+            const uint64_t index = indexer.index(cards);
+            indexer.unindex(index,canonical);
+            if (index>=indexer.size() || indexer.index(permuted)!=index || indexer.index(canonical)!=index) {
+                cout<<"hand index test: inconsistent index "<<index<<" for "<<show_cards(cards[0])<<' '<<show_cards(used&~cards[0])<<endl;
+                exit(1);
+            }
+        }
+    }
+
+    // Preflop indices agree with hand classes
+    const hand_indexer_t preflop = hand_indexer_t::holdem(0);
+    const hand_index_t hand_index;
+    vector<int> classes(preflop.size(),-1);
+    for (int c0 = 0; c0 < 52; c0++)
+        for (int c1 = 0; c1 < c0; c1++) {
+            const cards_t cards = cards_t(1)<<c0|cards_t(1)<<c1;
+            int& hand = classes[preflop.index(&cards)];
+            if (hand<0)
+                hand = hand_index(cards);
+            if (hand!=hand_index(cards)) {
+                cout<<"hand index test: "<<show_cards(cards)<<" shares a preflop index with "<<hands[hand]<<endl;
+                exit(1);
+            }
+        }
+}
+
+void regression_test_hand_index() {
+    timer_t timer("test hand index");
+    cout<<"hand index test: indexing all flops"<<endl;
+    const hand_indexer_t indexer = hand_indexer_t::holdem(1);
+    for (uint64_t i = 0; i < indexer.size(); i++) {
+        cards_t cards[2];
+        indexer.unindex(i,cards);
+        if (popcount(cards[0])!=2 || popcount(cards[1])!=3 || cards[0]&cards[1] || indexer.index(cards)!=i) {
+            cout<<"hand index test: flop index "<<i<<" fails to round trip"<<endl;
+            exit(1);
+        }
+    }
+    vector<bool> seen(indexer.size());
+    for (cards_t hole = 3; hole < cards_t(1)<<52; hole = next_subset(hole))
+        for (cards_t flop = 7; flop < cards_t(1)<<52; flop = next_subset(flop))
+            if (!(hole&flop)) {
+                const cards_t cards[2] = {hole,flop};
+                seen[indexer.index(cards)] = true;
+            }
+    if (std::count(seen.begin(),seen.end(),false)) {
+        cout<<"hand index test: some flop indices are never used"<<endl;
+        exit(1);
+    }
+    cout<<"hand index test passed!"<<endl;
+}
+
+void show_random(const vector<outcomes_t>& outcomes) {
+    if (do_nothing) return;
+    cout<<"outcomes vs. a random hand:"<<endl;
+    for (size_t i = 0; i < hands.size(); i++) {
+        const outcomes_t& o = outcomes[i];
+        const uint64_t total = o.total();
+        cout<<"  "<<hands[i]<<(hands[i].card0==hands[i].card1?"  ":" ")
+            <<": win "<<o.alice<<"/"<<total<<" = "<<(double)o.alice/total
+            <<", lose "<<o.bob<<"/"<<total<<" = "<<(double)o.bob/total
+            <<", tie "<<o.tie<<"/"<<total<<" = "<<(double)o.tie/total
+            <<", win+tie/2 = "<<(o.alice+.5*o.tie)/total<<endl;
+    }
+}
+
+void regression_test_random() {
+    timer_t timer("test random");
+    cout<<"random test: comparing all hands vs. a random hand"<<endl;
+    const vector<outcomes_t> outcomes = compare_random_hands();
+    const uint64_t boards = 2118760; // 50 choose 5
+    for (size_t i = 0; i < hands.size(); i++) {
+        const uint64_t combos = hands[i].card0==hands[i].card1?6:hands[i].suited?4:12;
+        if (outcomes[i].total()!=combos*boards*num_opponents) {
+            cout<<"random test: "<<hands[i]<<" has total "<<outcomes[i].total()<<", expected "<<combos*boards*num_opponents<<endl;
+            exit(1);
+        }
+    }
+    // Checked against exact.txt weighted by conditional hand probabilities
+    const struct { hand_t hand; uint64_t win,lose; } expected[2] = {
+        {hand_t(12,12,0),10689050508ULL,1827970020ULL},  // AA
+        {hand_t(5,0,0),7981752972ULL,15742612788ULL}}; // 72o
+    for (int e = 0; e < 2; e++)
+        for (size_t i = 0; i < hands.size(); i++)
+            if (hands[i]==expected[e].hand && (outcomes[i].alice!=expected[e].win || outcomes[i].bob!=expected[e].lose)) {
+                cout<<"random test: expected "<<hands[i]<<" to win "<<expected[e].win<<" and lose "<<expected[e].lose
+                    <<", got "<<outcomes[i].alice<<' '<<outcomes[i].bob<<endl;
+                exit(1);
+            }
+    cout<<"random test passed!"<<endl;
 }
 
 void usage(const char* program) {
@@ -664,11 +1956,25 @@ void usage(const char* program) {
           "  -g, --gpu      use only GPUs\n"
           "  -c, --cpu      use only CPUs\n"
           "  -n, --nop      count the number of hands we'd evaluate, but don't actually compute\n"
+          "  -t, --tune     rerun the kernel autotuner even if tune.txt has settings for our devices\n"
           "commands:\n"
           "  hands          print list of two card hold'em hands\n"
           "  test [n]       run some moderately expensive regression tests, with an optional size parameter\n"
           "  some [n]       compute win/loss/tie probabilities for some random pairs of hands\n"
           "  all            compute win/loss/tie probabilities for all pairs of hands\n"
+          "  combos [file]  compute all pairs of hands, and write all pairs of two card combos to file (default combos.bin)\n"
+          "  histogram <flop|turn> [bins] [file]\n"
+          "                 compute equity histograms of each hand vs. a random hand across flops or turns (default 50 bins,\n"
+          "                 written to flop.bin or turn.bin)\n"
+          "  table <turn|river> [file]\n"
+          "                 compute a table of equities vs. a random hand for every turn or river hand up to suit\n"
+          "                 permutation, written to turn.eq or river.eq (see equity_table.h)\n"
+          "  random         compute win/loss/tie probabilities for each hand vs. a uniformly random hand\n"
+          "  short          compute win/loss/tie probabilities for all pairs of short deck (6+) hands\n"
+          "  omaha <alice> <bob>...\n"
+          "                 compute win/loss/tie probabilities for pairs of four card Omaha hands (e.g., AsAhKsKh QcQdJcJd)\n"
+          "  omaha8 <alice> <bob>...\n"
+          "                 compute scoop/split/quarter probabilities for pairs of Omaha-8 (hi/lo 8-or-better) hands\n"
         <<flush;
 }
 
@@ -684,14 +1990,16 @@ int main(int argc, char** argv) {
         {"gpu",no_argument,0,'g'},
         {"all",no_argument,0,'a'},
         {"nop",no_argument,0,'n'},
+        {"tune",no_argument,0,'t'},
         {0,0,0,0}};
     int ch;
-    while ((ch = getopt_long(argc,argv,"cgan",options,0)) != -1)
+    while ((ch = getopt_long(argc,argv,"cgant",options,0)) != -1)
          switch (ch) {
              case 'c': device_types = CL_DEVICE_TYPE_CPU; break;
              case 'g': device_types = CL_DEVICE_TYPE_GPU; break;
              case 'a': device_types = CL_DEVICE_TYPE_ALL; break;
              case 'n': do_nothing = true; break;
+             case 't': retune = true; break;
              default: usage(program); return 1;
     }
     argc -= optind;
@@ -714,6 +2022,11 @@ int main(int argc, char** argv) {
 
     // Run a few tests
     test_score_hand();
+    test_score_low();
+    test_score_omaha();
+    test_score_omaha8();
+    test_score_short();
+    test_hand_index();
 
     // Print hands
     if (cmd=="hands") {
@@ -727,7 +2040,12 @@ int main(int argc, char** argv) {
     else if (cmd=="test") {
         size_t m = argc<2?1:atoi(argv[1]);
         regression_test_compare_hands(m);
+        regression_test_compare_hands(m,SHORT_DECK);
         regression_test_score_hand(m);
+        regression_test_compare_omaha();
+        regression_test_compare_omaha8();
+        regression_test_random();
+        regression_test_hand_index();
     }
 
     // Compute equities for some (mostly random) pairs of hands
@@ -740,14 +2058,89 @@ int main(int argc, char** argv) {
     }
 
     // Compute all hand pair equities
-    else if (cmd=="all") {
-        vector<hand_t> pairs;
-        for (size_t i = 0; i < hands.size(); i++)
-            for (size_t j = 0; j <= i; j++) {
-                pairs.push_back(hands[i]);
-                pairs.push_back(hands[j]);
+    else if (cmd=="all")
+        compare_many_hands(all_pairs(),true);
+
+    // Compute all hand pair equities, and expand them into a table of combo pair equities
+    else if (cmd=="combos") {
+        const char* path = argc<2?"combos.bin":argv[1];
+        vector<signatures_t> signatures;
+        vector<outcomes_t> outcomes = compare_many_hands(all_pairs(),true,FULL_DECK,&signatures);
+        if (!do_nothing)
+            write_combos(path,outcomes,signatures);
+    }
+
+    // Compute equities of all hands vs. a random hand
+    else if (cmd=="random")
+        show_random(compare_random_hands());
+
+    // Compute equity histograms across flops or turns
+    else if (cmd=="histogram") {
+        const string street = argc<2?"":argv[1];
+        const int bins = argc<3?50:atoi(argv[2]);
+        if ((street!="flop" && street!="turn") || bins<1) {
+            usage(program);
+            cerr<<"histogram expects flop or turn and a positive number of bins"<<endl;
+            return 1;
+        }
+        vector<outcomes_t> sums;
+        const vector<uint32_t> histograms = equity_histograms(street=="flop"?3:4,bins,&sums);
+        if (!do_nothing) {
+            show_random(sums);
+            write_histograms(argc<4?(street+".bin").c_str():argv[3],histograms);
+        }
+    }
+
+    // Compute turn or river equity tables
+    else if (cmd=="table") {
+        const string street = argc<2?"":argv[1];
+        if (street!="turn" && street!="river") {
+            usage(program);
+            cerr<<"table expects turn or river"<<endl;
+            return 1;
+        }
+        const string path = argc<3?street+".eq":argv[2];
+        write_equity_table(path.c_str(),street=="turn"?4:5);
+        if (!do_nothing)
+            check_equity_table(path.c_str(),street=="turn"?100:1000);
+    }
+
+    // Compute all short deck hand pair equities
+    else if (cmd=="short")
+        compare_many_hands(all_pairs(short_hands),true,SHORT_DECK);
+
+    // Compute Omaha or Omaha-8 equities for the given pairs of hands
+    else if (cmd=="omaha" || cmd=="omaha8") {
+        if (argc<3 || argc%2!=1) {
+            usage(program);
+            cerr<<"omaha expects pairs of hands"<<endl;
+            return 1;
+        }
+        vector<cards_t> pairs;
+        for (int i = 1; i < argc; i++) {
+            bool valid = strlen(argv[i])==8;
+            for (int j = 0; valid && j < 4; j++)
+                valid = strchr(show_card,argv[i][2*j]) && strchr(show_suit,argv[i][2*j+1]);
+            if (!valid) {
+                cerr<<"invalid omaha hand: "<<argv[i]<<endl;
+                return 1;
             }
-        compare_many_hands(pairs,true);
+            pairs.push_back(read_cards(argv[i]));
+        }
+        for (size_t i = 0; i < pairs.size(); i += 2)
+            if (popcount(pairs[i])!=4 || popcount(pairs[i+1])!=4 || pairs[i]&pairs[i+1]) {
+                cerr<<"omaha hands "<<argv[i+1]<<" and "<<argv[i+2]<<" repeat a card"<<endl;
+                return 1;
+            }
+        if (cmd=="omaha") {
+            const vector<outcomes_t> outcomes = compare_omaha_hands(pairs,compare_omaha_opencl);
+            for (size_t i = 0; i < outcomes.size(); i++)
+                show_comparison(string(argv[2*i+1]),string(argv[2*i+2]),outcomes[i]);
+        } else {
+            const vector<split_outcomes_t> outcomes = compare_omaha_hands(pairs,compare_omaha8_opencl);
+            for (size_t i = 0; i < outcomes.size(); i++)
+                show_split(argv[2*i+1],argv[2*i+2],outcomes[i]);
+        }
     }
 
     // Didn't understand command
@@ -0,0 +1,257 @@
+// Suit isomorphic hand indexing
+
+#include <algorithm>
+#include <cassert>
+#include "hand_index.h"
+
+using std::vector;
+using std::sort;
+using std::swap;
+
+namespace {
+
+// Per round card counts of one suit, four bits per round with the first round highest
+const int count_bits = 4;
+const int tuple_bits = count_bits*hand_indexer_t::max_rounds;
+
+inline int round_count(uint64_t tuple, int round) {
+    return tuple>>count_bits*(hand_indexer_t::max_rounds-1-round)&((1<<count_bits)-1);
+}
+
+inline uint64_t suit_tuple(uint64_t counts, int suit) {
+    return counts>>tuple_bits*(3-suit)&((uint64_t(1)<<tuple_bits)-1);
+}
+
+inline int popcount(uint32_t x) {
+    return __builtin_popcount(x);
+}
+
+// Binomial coefficients of up to 13 ranks, so that ranking rank sets needs no division
+struct binomials_t {
+    uint32_t c[14][14];
+
+    binomials_t() {
+        for (int n = 0; n < 14; n++)
+            for (int k = 0; k < 14; k++)
+                c[n][k] = k==0?1:n==0?0:c[n-1][k-1]+c[n-1][k];
+    }
+};
+const binomials_t binomials;
+
+inline uint32_t choose13(int n, int k) {
+    return binomials.c[n][k];
+}
+
+// n choose k for large n and small k, exact as long as the result fits
+inline uint64_t choose(uint64_t n, int k) {
+    if (k==1)
+        return n;
+    if (n<uint64_t(k))
+        return 0;
+    uint64_t r = 1;
+    for (int i = 1; i <= k; i++)
+        r = r*(n-k+i)/i;
+    return r;
+}
+
+// Largest b <= hi with choose(b,k) <= r, for k >= 1
+uint64_t invert_choose(uint64_t r, int k, uint64_t hi) {
+    uint64_t lo = k-1; // choose(lo,k) == 0 <= r
+    while (lo<hi) {
+        const uint64_t mid = lo+(hi-lo+1)/2;
+        if (choose(mid,k)<=r)
+            lo = mid;
+        else
+            hi = mid-1;
+    }
+    return lo;
+}
+
+// Colex rank of a set of ranks among the ranks not in used
+inline uint32_t colex(uint32_t set, uint32_t used) {
+    uint32_t r = 0;
+    for (int j = 1; set; j++) {
+        const int p = __builtin_ctz(set);
+        set &= set-1;
+        r += choose13(popcount(~used&((1<<p)-1)),j);
+    }
+    return r;
+}
+
+// Inverse of colex: the set of m ranks outside used with colex rank r
+inline uint32_t uncolex(uint32_t r, int m, uint32_t used) {
+    uint32_t set = 0;
+    for (int j = m; j >= 1; j--) {
+        int pos = j-1;
+        while (pos<12 && choose13(pos+1,j)<=r)
+            pos++;
+        r -= choose13(pos,j);
+        // Find the pos'th rank not in used
+        uint32_t free = ~used&0x1fff;
+        for (; pos; pos--)
+            free &= free-1;
+        set |= free&-free;
+    }
+    return set;
+}
+
+// Sort suits by decreasing tuple, breaking ties by decreasing index
+inline void sort_suits(uint64_t* tuples, uint64_t* indices) {
+    for (int i = 1; i < 4; i++)
+        for (int j = i; j > 0 && (tuples[j-1]<tuples[j] || (tuples[j-1]==tuples[j] && indices[j-1]<indices[j])); j--) {
+            swap(tuples[j-1],tuples[j]);
+            swap(indices[j-1],indices[j]);
+        }
+}
+
+}
+
+hand_indexer_t::hand_indexer_t(int rounds, const int* cards_per_round)
+    :rounds_(rounds) {
+    assert(0<rounds && rounds<=max_rounds);
+    for (int i = 0; i < rounds; i++) {
+        assert(0<cards_per_round[i] && cards_per_round[i]<=13);
+        this->cards_per_round[i] = cards_per_round[i];
+    }
+    uint64_t suits[4] = {0,0,0,0};
+    add_configurations(0,0,suits,cards_per_round[0]);
+    sort(counts.begin(),counts.end());
+    counts.erase(std::unique(counts.begin(),counts.end()),counts.end());
+
+    // Each group of suits with equal tuples contributes a factor of the number of multisets of its suit indices
+    offsets.push_back(0);
+    for (size_t c = 0; c < counts.size(); c++) {
+        configuration_t config;
+        uint64_t size = 1;
+        for (int s = 0; s < 4; s++) {
+            const uint64_t tuple = suit_tuple(counts[c],s);
+            config.suit_sizes[s] = 1;
+            for (int i = 0, used = 0; i < rounds; i++) {
+                config.suit_sizes[s] *= choose13(13-used,round_count(tuple,i));
+                used += round_count(tuple,i);
+            }
+            config.groups[s] = 0;
+            config.radices[s] = 1;
+        }
+        for (int s = 0, k; s < 4; s += k) {
+            const uint64_t tuple = suit_tuple(counts[c],s);
+            for (k = 1; s+k < 4 && suit_tuple(counts[c],s+k)==tuple; k++);
+            config.groups[s] = k;
+            config.radices[s] = choose(config.suit_sizes[s]+k-1,k);
+            size *= config.radices[s];
+        }
+        configurations.push_back(config);
+        offsets.push_back(offsets.back()+size);
+    }
+}
+
+// Distribute the remaining cards of each round among the suits, recording each sorted assignment of counts
+void hand_indexer_t::add_configurations(int round, int suit, uint64_t* suits, int left) {
+    if (round==rounds_) {
+        uint64_t sorted[4] = {suits[0],suits[1],suits[2],suits[3]};
+        sort(sorted,sorted+4);
+        counts.push_back(sorted[3]<<3*tuple_bits|sorted[2]<<2*tuple_bits|sorted[1]<<tuple_bits|sorted[0]);
+        return;
+    }
+    int total = 0;
+    for (int i = 0; i < round; i++)
+        total += round_count(suits[suit],i);
+    // The last suit takes whatever is left
+    for (int m = suit==3?left:0; m <= left && total+m <= 13; m++) {
+        const uint64_t bits = uint64_t(m)<<count_bits*(max_rounds-1-round);
+        suits[suit] += bits;
+        if (suit==3)
+            add_configurations(round+1,0,suits,round+1<rounds_?cards_per_round[round+1]:0);
+        else
+            add_configurations(round,suit+1,suits,left-m);
+        suits[suit] -= bits;
+    }
+}
+
+hand_indexer_t hand_indexer_t::holdem(int street) {
+    assert(0<=street && street<4);
+    const int cards_per_round[4] = {2,3,1,1};
+    return hand_indexer_t(street+1,cards_per_round);
+}
+
+uint64_t hand_indexer_t::index(const cards_t* cards) const {
+    // Rank each suit's sequence of rank sets, with earlier rounds more significant
+    uint64_t tuples[4], indices[4];
+    for (int s = 0; s < 4; s++) {
+        uint32_t used = 0;
+        uint64_t tuple = 0, index = 0;
+        for (int i = 0; i < rounds_; i++) {
+            const uint32_t set = cards[i]>>13*s&0x1fff;
+            assert(!(set&used));
+            const int m = popcount(set);
+            index = index*choose13(13-popcount(used),m)+colex(set,used);
+            tuple |= uint64_t(m)<<count_bits*(max_rounds-1-i);
+            used |= set;
+        }
+        tuples[s] = tuple;
+        indices[s] = index;
+    }
+    sort_suits(tuples,indices);
+
+    // Find the configuration
+    const uint64_t key = tuples[0]<<3*tuple_bits|tuples[1]<<2*tuple_bits|tuples[2]<<tuple_bits|tuples[3];
+    const vector<uint64_t>::const_iterator it = std::lower_bound(counts.begin(),counts.end(),key);
+    assert(it!=counts.end() && *it==key);
+    const configuration_t& config = configurations[it-counts.begin()];
+
+    // Rank the multiset of indices in each group of interchangeable suits, mapping the decreasing indices
+    // a_0 >= a_1 >= ... to the strictly decreasing a_j+k-1-j and taking their colex rank.
+    uint64_t index = 0;
+    for (int s = 0; s < 4; s += config.groups[s]) {
+        const int k = config.groups[s];
+        uint64_t rank = 0;
+        for (int j = 0; j < k; j++)
+            rank += choose(indices[s+j]+k-1-j,k-j);
+        index = index*config.radices[s]+rank;
+    }
+    return offsets[it-counts.begin()]+index;
+}
+
+void hand_indexer_t::unindex(uint64_t index, cards_t* cards) const {
+    assert(index<size());
+    const size_t c = std::upper_bound(offsets.begin(),offsets.end(),index)-offsets.begin()-1;
+    const configuration_t& config = configurations[c];
+    index -= offsets[c];
+
+    // Peel off groups from last to first, since index puts the first group most significant
+    uint64_t indices[4];
+    for (int s = 3; s >= 0; s--) {
+        const int k = config.groups[s];
+        if (!k) continue;
+        uint64_t rank = index%config.radices[s];
+        index /= config.radices[s];
+        for (int j = 0; j < k; j++) {
+            const uint64_t b = invert_choose(rank,k-j,config.suit_sizes[s]+k-2-j);
+            rank -= choose(b,k-j);
+            indices[s+j] = b-(k-1-j);
+        }
+    }
+
+    // Unrank each suit's rank sets, assigning suits in sorted order
+    for (int i = 0; i < rounds_; i++)
+        cards[i] = 0;
+    for (int s = 0; s < 4; s++) {
+        const uint64_t tuple = suit_tuple(counts[c],s);
+        uint32_t digits[max_rounds];
+        uint64_t index = indices[s];
+        for (int i = rounds_-1; i >= 0; i--) {
+            int used = 0;
+            for (int j = 0; j < i; j++)
+                used += round_count(tuple,j);
+            const uint32_t radix = choose13(13-used,round_count(tuple,i));
+            digits[i] = index%radix;
+            index /= radix;
+        }
+        uint32_t used = 0;
+        for (int i = 0; i < rounds_; i++) {
+            const uint32_t set = uncolex(digits[i],round_count(tuple,i),used);
+            cards[i] |= cards_t(set)<<13*s;
+            used |= set;
+        }
+    }
+}
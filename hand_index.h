@@ -0,0 +1,61 @@
+// Suit isomorphic hand indexing
+//
+// Maps a hand dealt in rounds (e.g., two hole cards, a three card flop, a turn, and a river) to a dense index in
+// [0,size()), so that two hands get the same index exactly when they differ by a permutation of suits.  Cards use
+// the same 52-entry bit set as score.h and batch.h.
+//
+// The scheme follows Waugh, "A fast and optimal hand isomorphism algorithm".  Each suit's sequence of per round rank
+// sets is ranked in colex order, suits with the same number of cards in every round are interchangeable and so are
+// ranked as a multiset, and the possible assignments of per round card counts to suits are laid out consecutively.
+// Indexing and unindexing need only a small table of these count configurations.
+
+#ifndef __hand_index_h__
+#define __hand_index_h__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Same as score.h
+typedef uint64_t cards_t;
+
+class hand_indexer_t {
+public:
+    static const int max_rounds = 4;
+
+    // Set up an indexer for hands dealt with the given number of cards in each round
+    hand_indexer_t(int rounds, const int* cards_per_round);
+
+    // Hold'em indexer for a street: 0 for preflop, 1 for the flop, 2 for the turn, or 3 for the river
+    static hand_indexer_t holdem(int street);
+
+    int rounds() const { return rounds_; }
+
+    // Number of hands up to suit permutation
+    uint64_t size() const { return offsets.back(); }
+
+    // Index a hand, given the set of cards dealt in each round
+    uint64_t index(const cards_t* cards) const;
+
+    // Fill in the set of cards dealt in each round for a canonical hand with the given index
+    void unindex(uint64_t index, cards_t* cards) const;
+
+private:
+    struct configuration_t {
+        uint64_t suit_sizes[4]; // Number of sequences of rank sets with each suit's counts
+        int groups[4];          // Number of suits in the group of equal counts starting at each suit, or 0 inside a group
+        uint64_t radices[4];    // Number of multisets of suit indices for the group starting at each suit
+    };
+
+    int rounds_;
+    int cards_per_round[max_rounds];
+    // Per round card counts of the four suits, packed and sorted in decreasing order, for each configuration.
+    // Configurations are sorted by counts, and configuration i owns indices [offsets[i],offsets[i+1]).
+    std::vector<uint64_t> counts;
+    std::vector<configuration_t> configurations;
+    std::vector<uint64_t> offsets;
+
+    void add_configurations(int round, int suit, uint64_t* counts, int left);
+};
+
+#endif
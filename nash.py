@@ -2,6 +2,11 @@
 
 from __future__ import division
 from numpy import *
+from fractions import Fraction
+try:
+    from rational import rational as _rational,argmin_ratio as _argmin_ratio,simplex as _simplex,simplex_batch as _simplex_batch
+except ImportError: # Only needed for exact arithmetic
+    _rational = None
 
 '''We implement a fairly unoptimized version of the simplex method for linear programming following
 Wikipedia: http://en.wikipedia.org/wiki/Simplex_method.  Thus, our tableu has the structure
@@ -39,11 +44,17 @@ def solve_tableau(T,B,N):
         if T[0,c]<=0:
             break # We've hit a local optimum, which is therefore a global optimum
         # Pick a variable to leave
-        leavings, = nonzero(T[k:,c]>0)
-        if not len(leavings):
-            raise Unbounded('unbounded linear program')
-        rows = k+leavings
-        leave = leavings[argmin(T[rows,-1]/T[rows,c])]
+        if _rational and T.dtype==dtype(_rational):
+            # Same as below, but without dividing
+            leave = _argmin_ratio(T[k:,-1],T[k:,c])
+            if leave<0:
+                raise Unbounded('unbounded linear program')
+        else:
+            leavings, = nonzero(T[k:,c]>0)
+            if not len(leavings):
+                raise Unbounded('unbounded linear program')
+            rows = k+leavings
+            leave = leavings[argmin(T[rows,-1]/T[rows,c])]
         r = k+leave
         # Perform the pivot
         T[r] /= T[r,c]
@@ -52,9 +63,37 @@ def solve_tableau(T,B,N):
         # Update the sets of basis and nonbasis variables
         N[enter],B[leave] = B[leave],N[enter]
 
+def fractions(x):
+    '''Convert an array of exact numbers (rationals or integers) to an object array of arbitrary precision fractions'''
+    x = asarray(x)
+    return array([Fraction(int(v.numerator),int(v.denominator)) for v in x.flat],dtype=object).reshape(x.shape)
+
 def simplex_method(c,A,b):
     '''Minimize dot(c,x) s.t. Ax = b, x >= 0 using the simplex method, and return dot(c,x),x.
-    If c,A,b are fractions, the result is exact.'''
+    If c,A,b are fractions, the result is exact.  If fixed precision rationals overflow, we solve again with
+    arbitrary precision fractions, and convert the results back if they fit.  Rational problems are solved by the
+    native revised simplex method, which pivots exactly as simplex_method_dtype does.'''
+    try:
+        if _rational and A.dtype==dtype(_rational):
+            status,f,x = _simplex(c,A,b)
+            if status=='unbounded':
+                raise Unbounded('unbounded linear program')
+            elif status=='infeasible':
+                raise Infeasible('infeasible linear program')
+            return f,x
+        return simplex_method_dtype(c,A,b)
+    except Unbounded:
+        raise
+    except OverflowError:
+        if A.dtype==object:
+            raise
+    f,x = simplex_method_dtype(*map(fractions,(c,A,b)))
+    try:
+        return array(f).astype(A.dtype)[()],x.astype(A.dtype)
+    except OverflowError:
+        return f,x
+
+def simplex_method_dtype(c,A,b):
     # Phase 1: Add slack variables to get an initial canonical tableu, and solve
     (n,m),dtype = A.shape,A.dtype
     assert c.shape==(m,)
@@ -62,11 +101,13 @@ def simplex_method(c,A,b):
     T = vstack([hstack([1,zeros(m+1,dtype),-ones(n,dtype),0]).reshape(1,-1),
                 hstack([0,1,-c,zeros(n+1,dtype)]).reshape(1,-1),
                 hstack([zeros((n,2),dtype),A,eye(n,dtype=dtype),b.reshape(-1,1)])])
+    if dtype==object:
+        T = fractions(T) # Make sure integer entries divide exactly
     N = arange(m)
     B = m+arange(n)
     solve_tableau(T,B,N)
     # Check for infeasibility
-    if T[0,-1]<0:
+    if T[0,-1]>0:
         raise Infeasible('infeasible linear program')
     # Verify that the auxiliary slack variables are nonbasic.  This is not always the
     # case--they could be basic but just happen to be zero--but we'll deal with that later.
@@ -106,4 +147,43 @@ def zero_sum_nash_equilibrium_side(payoff):
 def zero_sum_nash_equilibrium(payoff):
     alice = zero_sum_nash_equilibrium_side(payoff)
     bob = zero_sum_nash_equilibrium_side(-payoff.T)
+    if object in (alice.dtype,bob.dtype): # A solve needed arbitrary precision
+        payoff,alice,bob = map(fractions,(payoff,alice,bob))
     return dot(payoff,bob).max(),alice,bob
+
+def box_nash_equilibria(c,M):
+    '''Solve a stack of zero sum games where Alice picks x in [0,1]^n to maximize dot(x,c[k])+dot(x,dot(M[k],y)) and
+    Bob picks y in [0,1]^p to minimize it.  Fixed bet poker is such a game, with x and y each hand's call probability.
+    All games are solved at once by simplex_batch, which runs in parallel and warm starts each game from the previous
+    one, so neighbouring games (such as neighbouring bet sizes) should be adjacent.  Returns a list of (equity,x,y),
+    with None for games whose linear programs overflow.'''
+    c = asarray(c).astype(_rational)
+    M = asarray(M).astype(_rational)
+    k,n,p = M.shape
+    assert c.shape==(k,n)
+    # Alice: min -c.x + sum(u) s.t. x + s = 1, M.T x + u - r = 0, where u = max(0,-M.T x) is Bob's best response
+    A = zeros((k,n+p,2*(n+p)),_rational)
+    A[:,:n,:n] = A[:,:n,n:2*n] = eye(n,dtype=_rational)
+    A[:,n:,:n] = M.transpose(0,2,1)
+    A[:,n:,2*n:2*n+p] = eye(p,dtype=_rational)
+    A[:,n:,2*n+p:] = -eye(p,dtype=_rational)
+    cost = hstack([-c,zeros((k,n),_rational),ones((k,p),_rational),zeros((k,p),_rational)])
+    b = hstack([ones((k,n),_rational),zeros((k,p),_rational)])
+    alice = _simplex_batch(cost,A,b)
+    # Bob: min sum(v) s.t. y + s = 1, v - M y - r = c, where v = max(0,c + M y) is Alice's best response
+    A = zeros((k,p+n,2*(p+n)),_rational)
+    A[:,:p,:p] = A[:,:p,p:2*p] = eye(p,dtype=_rational)
+    A[:,p:,:p] = -M
+    A[:,p:,2*p:2*p+n] = eye(n,dtype=_rational)
+    A[:,p:,2*p+n:] = -eye(n,dtype=_rational)
+    cost = hstack([zeros((k,2*p),_rational),ones((k,n),_rational),zeros((k,n),_rational)])
+    b = hstack([ones((k,p),_rational),c])
+    bob = _simplex_batch(cost,A,b)
+    results = []
+    for (sa,fa,xa,_),(sb,fb,xb,_) in zip(alice,bob):
+        if 'overflow' in (sa,sb):
+            results.append(None)
+        else:
+            assert sa==sb=='optimal' and -fa==fb # Boxes are compact, so both sides have optimal solutions of equal value
+            results.append((fb,xa[:n],xb[:p]))
+    return results
@@ -8,6 +8,10 @@
 #include <stdexcept>
 #include <typeinfo>
 #include <iostream>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <ctime>
 #include <Python/Python.h>
 #include <Python/structmember.h>
 #include <numpy/arrayobject.h>
@@ -55,10 +59,10 @@ template<class I> inline I safe_neg(I x) {
 template<class I> inline I safe_abs(I x) {
     if (x>=0)
         return x;
-    I nx = -x;
-    if (nx<0)
+    // Check before negating, since signed overflow is undefined and the compiler may drop a check afterwards
+    if (x==numeric_limits<I>::min())
         throw overflow();
-    return nx;
+    return -x;
 }
 
 // Check for negative numbers without compiler warnings for unsigned types
@@ -79,7 +83,7 @@ template<class dst,class src> inline dst safe_cast(src x) {
     return y;
 }
 
-template<class I> I gcd(I x, I y) {
+template<class I> I euclid_gcd(I x, I y) {
     x = safe_abs(x);
     y = safe_abs(y);
     if (x < y)
@@ -91,6 +95,46 @@ template<class I> I gcd(I x, I y) {
     return x;
 }
 
+template<class I> inline I gcd(I x, I y) {
+    return euclid_gcd(x,y);
+}
+
+inline int ctz(uint128_t x) {
+    const uint64_t lo = x;
+    return lo?__builtin_ctzll(lo):64+__builtin_ctzll(uint64_t(x>>64));
+}
+
+// 128-bit division is a slow library call, so use Stein's binary gcd, which needs only shifts and subtractions
+template<class I> I binary_gcd(I x, I y) {
+    uint128_t a = safe_abs(x),
+              b = safe_abs(y);
+    if (!a || !b)
+        return a|b;
+    const int shift = ctz(a|b);
+    a >>= ctz(a);
+    do {
+        b >>= ctz(b);
+        if (a > b)
+            swap(a,b);
+        // Finish in 64 bits once both operands fit
+        if (!(b>>64)) {
+            uint64_t a64 = a, b64 = b;
+            while (b64 -= a64) {
+                b64 >>= __builtin_ctzll(b64);
+                if (a64 > b64)
+                    swap(a64,b64);
+            }
+            return I(a64)<<shift;
+        }
+        b -= a;
+    } while (b);
+    return a<<shift;
+}
+
+template<> inline int128_t gcd(int128_t x, int128_t y) {
+    return binary_gcd(x,y);
+}
+
 template<class I> I lcm(I x, I y) {
     if (!x || !y)
         return 0;
@@ -101,6 +145,27 @@ template<class I> I lcm(I x, I y) {
     return safe_abs(lcm);
 }
 
+// Set hi,lo to the 256-bit product of x and y
+inline void multiply_wide(uint128_t x, uint128_t y, uint128_t& hi, uint128_t& lo) {
+    const uint128_t x0 = uint64_t(x), x1 = x>>64, y0 = uint64_t(y), y1 = y>>64;
+    const uint128_t p00 = x0*y0, p01 = x0*y1, p10 = x1*y0;
+    const uint128_t mid = (p00>>64)+uint64_t(p01)+uint64_t(p10);
+    lo = mid<<64|uint64_t(p00);
+    hi = x1*y1+(p01>>64)+(p10>>64)+(mid>>64);
+}
+
+// Sign of x0*y0-x1*y1 for y0,y1 > 0
+int compare_products(int128_t x0, uint128_t y0, int128_t x1, uint128_t y1) {
+    const int s0 = x0<0?-1:x0>0, s1 = x1<0?-1:x1>0;
+    if (s0!=s1 || !s0)
+        return s0<s1?-1:s0>s1;
+    uint128_t h0, l0, h1, l1;
+    multiply_wide(s0*x0,y0,h0,l0);
+    multiply_wide(s1*x1,y1,h1,l1);
+    const int c = h0!=h1?(h0<h1?-1:1):l0!=l1?(l0<l1?-1:1):0;
+    return s0*c;
+}
+
 // Fixed precision rational numbers
 
 class rational {
@@ -150,13 +215,11 @@ public:
     }
 
     rational operator+(rational x) const {
-        // Note that the numerator computation can never overflow int128_t, since each term is strictly under 2**128/4 (since d > 0).
-        return rational(DI(n)*x.d()+DI(d())*x.n,DI(d())*x.d(),fast());
+        return add(x,false);
     }
 
     rational operator-(rational x) const {
-        // We're safe from overflow as with +
-        return rational(DI(n)*x.d()-DI(d())*x.n,DI(d())*x.d(),fast());
+        return add(x,true);
     }
 
     rational operator*(rational x) const {
@@ -215,6 +278,38 @@ public:
     }
 
 private:
+    // Sum or difference.  The fast paths stay in 64 bits and fall through to the general 128-bit path whenever an
+    // intermediate overflows, so overflow is still only reported if the reduced result doesn't fit.
+    rational add(rational x, bool sub) const {
+        I r;
+        if (dmm==x.dmm) {
+            // Equal denominators, including two integers, need only a 64-bit gcd against d
+            if (!(sub?__builtin_sub_overflow(n,x.n,&r):__builtin_add_overflow(n,x.n,&r)) && r!=numeric_limits<I>::min())
+                return dmm?rational(r,d(),fast()):rational(r);
+        } else if (!dmm || !x.dmm) {
+            // An integer plus p/q is (iq+p)/q, which is already reduced
+            I p;
+            const bool ok = dmm ? !__builtin_mul_overflow(x.n,d(),&p) && !(sub?__builtin_sub_overflow(n,p,&r):__builtin_add_overflow(n,p,&r))
+                                : !__builtin_mul_overflow(n,x.d(),&p) && !(sub?__builtin_sub_overflow(p,x.n,&r):__builtin_add_overflow(p,x.n,&r));
+            if (ok) {
+                rational y;
+                y.n = r;
+                y.dmm = dmm?dmm:x.dmm;
+                return y;
+            }
+        } else {
+            // Both products and the common denominator usually fit in 64 bits
+            I a, b, q;
+            if (   !__builtin_mul_overflow(n,x.d(),&a) && !__builtin_mul_overflow(x.n,d(),&b)
+                && !__builtin_mul_overflow(d(),x.d(),&q)
+                && !(sub?__builtin_sub_overflow(a,b,&r):__builtin_add_overflow(a,b,&r)) && r!=numeric_limits<I>::min())
+                return rational(r,q,fast());
+        }
+        // Note that the numerator computation can never overflow int128_t, since each term is strictly under 2**128/4 (since d > 0).
+        const DI a = DI(n)*x.d(), b = DI(d())*x.n;
+        return rational(sub?a-b:a+b,DI(d())*x.d(),fast());
+    }
+
     struct unusable { void f(){} };
     typedef void (unusable::*safe_bool)();
 public:
@@ -271,6 +366,102 @@ template<> inline double cast(rational x) { return (double)x.n/x.d(); }
 template<> inline bool cast(rational x) { return x.n!=0; }
 template<> inline rational cast(bool b) { return b; }
 
+// Compact rationals
+//
+// Probability tables and products of small counts fit in 32-bit numerators and denominators, so rational32 stores them
+// in half the space.  It's purely a storage format: arithmetic widens to rational, which can't overflow where rational32
+// would, and narrowing back throws overflow unless the value fits.
+
+struct rational32 {
+    int32_t n, dmm;
+};
+
+template<> inline rational cast(rational32 x) {
+    rational r;
+    r.n = x.n;
+    r.dmm = x.dmm;
+    return r;
+}
+
+template<> inline rational32 cast(rational x) {
+    rational32 r;
+    r.n = safe_cast<int32_t>(x.n);
+    r.dmm = safe_cast<int32_t>(x.dmm);
+    return r;
+}
+
+#define DEFINE_RATIONAL32_CAST(T) \
+    template<> inline T cast(rational32 x) { return cast<T>(cast<rational>(x)); } \
+    template<> inline rational32 cast(T x) { return cast<rational32>(cast<rational>(x)); }
+DEFINE_RATIONAL32_CAST(int8_t)
+DEFINE_RATIONAL32_CAST(uint8_t)
+DEFINE_RATIONAL32_CAST(int16_t)
+DEFINE_RATIONAL32_CAST(uint16_t)
+DEFINE_RATIONAL32_CAST(int32_t)
+DEFINE_RATIONAL32_CAST(uint32_t)
+DEFINE_RATIONAL32_CAST(int64_t)
+DEFINE_RATIONAL32_CAST(uint64_t)
+DEFINE_RATIONAL32_CAST(bool)
+template<> inline float  cast(rational32 x) { return cast<float >(cast<rational>(x)); }
+template<> inline double cast(rational32 x) { return cast<double>(cast<rational>(x)); }
+
+// Exact sums of rationals
+//
+// Adding rationals one at a time reduces by a 128-bit gcd after every term.  An accumulator instead keeps an unreduced
+// 128-bit numerator and denominator, so a term over the current denominator costs a single addition, and a gcd is
+// needed only when the denominator changes.  If even the reduced partial sum doesn't fit in 128 bits we throw overflow,
+// so results are always exact.
+
+class accumulator {
+    typedef rational::DI DI;
+    DI n, d; // d > 0, but n/d need not be reduced
+
+    static void reduce(DI& n, DI& d) {
+        const DI g = gcd(n,d);
+        n /= g;
+        d /= g;
+    }
+public:
+    accumulator()
+        :n(0),d(1) {}
+
+    // Add p/q, given q > 0
+    void add(DI p, DI q) {
+        DI s;
+        if (q==d && !__builtin_add_overflow(n,p,&s)) {
+            n = s;
+            return;
+        }
+        for (bool reduced = false;; reduced = true) {
+            const DI g = gcd(d,q), dg = d/g, qg = q/g;
+            DI a, b, e;
+            if (   !__builtin_mul_overflow(n,qg,&a) && !__builtin_mul_overflow(p,dg,&b)
+                && !__builtin_add_overflow(a,b,&s) && !__builtin_mul_overflow(d,qg,&e)) {
+                n = s;
+                d = e;
+                return;
+            }
+            if (reduced)
+                throw overflow();
+            reduce(n,d);
+            reduce(p,q);
+        }
+    }
+
+    void add(rational x) {
+        add(x.n,x.d());
+    }
+
+    // Add x*y without reducing the product.  Neither the numerator nor the denominator can overflow int128_t.
+    void add_product(rational x, rational y) {
+        add(DI(x.n)*y.n,DI(x.d())*y.d());
+    }
+
+    rational value() const {
+        return rational(n,d);
+    }
+};
+
 bool scan_rational(const char*& s, rational& x) {
     long n,d;
     int offset;
@@ -290,21 +481,435 @@ bool scan_rational(const char*& s, rational& x) {
     return true;
 }
 
+// Sign of a0/b0-a1/b1 for b0,b1 > 0, without dividing
+inline int compare_ratios(rational a0, rational b0, rational a1, rational b1) {
+    typedef rational::DI DI;
+    return compare_products(DI(a0.n)*b0.d(),DI(a1.d())*b1.n,DI(a1.n)*b1.d(),DI(a0.d())*b0.n);
+}
+
+// Exact revised simplex method
+//
+// Minimizes c.x s.t. Ax = b, x >= 0.  Pivots follow nash.py's tableau simplex_method exactly, so the two give the same
+// solutions: phase 1 starts from a basis of artificial variables, Dantzig's rule enters the first most negative reduced
+// cost in nonbasis order, and the ratio test leaves the first minimizing row.  Bland's rule (smallest indices) can be
+// used instead.  Dantzig's rule can cycle on degenerate problems, so if a run of degenerate pivots revisits a state we
+// switch to Bland's rule until the objective improves; problems that the tableau solves are unaffected.  Rather than a
+// full tableau with its identity block, we store the columns of A sparsely and update a dense basis inverse by a rank
+// one pivot, so an iteration costs O(m^2+nnz(A)) rational operations.
+//
+// When solving a sequence of similar problems, the optimal basis of one is often feasible or nearly optimal for the
+// next.  solve can start from such a basis, skipping phase 1 if it turns out to be feasible.
+
+struct simplex_result {
+    enum status_t { optimal, unbounded, infeasible } status;
+    rational value;
+    std::vector<rational> x;
+    std::vector<int> basis; // Final basis if optimal or unbounded, for warm starts
+    int pivots;
+};
+
+class simplex_solver {
+    struct entry {
+        int i;
+        rational v;
+    };
+
+    const int m, n; // A is m by n.  Variables n+i are artificial, with column e_i.
+    const bool bland;
+    std::vector<std::vector<entry> > columns; // Nonzeros of the columns of A
+    std::vector<rational> b; // Right hand side, flipped to be nonnegative
+    std::vector<rational> binv; // Basis inverse, m by m row major
+    std::vector<rational> xb; // Values of the basic variables
+    std::vector<int> basis, nonbasis;
+    int pivots;
+
+    // Row r of B^{-1}A for variable j
+    rational tableau(int r, int j) const {
+        if (j>=n)
+            return binv[r*m+j-n];
+        accumulator sum;
+        for (size_t k = 0; k < columns[j].size(); k++)
+            sum.add_product(binv[r*m+columns[j][k].i],columns[j][k].v);
+        return sum.value();
+    }
+
+    // Reduced cost of variable j given duals y
+    rational reduced(const std::vector<rational>& costs, const std::vector<rational>& y, int j) const {
+        if (j>=n)
+            return costs[j]-y[j-n];
+        accumulator sum;
+        sum.add(costs[j]);
+        for (size_t k = 0; k < columns[j].size(); k++)
+            sum.add_product(-y[columns[j][k].i],columns[j][k].v);
+        return sum.value();
+    }
+
+    // Column j of B^{-1}A
+    void tableau(int j, std::vector<rational>& u) const {
+        for (int r = 0; r < m; r++)
+            u[r] = tableau(r,j);
+    }
+
+    void pivot(int r, const std::vector<rational>& u) {
+        pivots++;
+        const rational inv = inverse(u[r]);
+        for (int k = 0; k < m; k++)
+            binv[r*m+k] = binv[r*m+k]*inv;
+        xb[r] = xb[r]*inv;
+        for (int i = 0; i < m; i++)
+            if (i!=r && u[i]) {
+                for (int k = 0; k < m; k++)
+                    if (binv[r*m+k])
+                        binv[i*m+k] = binv[i*m+k]-u[i]*binv[r*m+k];
+                xb[i] = xb[i]-u[i]*xb[r];
+            }
+    }
+
+    // Optimize the given costs over the current nonbasis.  Returns false if unbounded.
+    bool optimize(const std::vector<rational>& costs) {
+        std::vector<rational> y(m), u(m);
+        std::set<std::vector<int> > degenerate; // States since the last improving pivot
+        bool cycling = false;
+        for (;;) {
+            const bool bland = this->bland || cycling;
+            // Duals y = c_B^T B^{-1}
+            for (int k = 0; k < m; k++) {
+                accumulator sum;
+                for (int r = 0; r < m; r++)
+                    if (costs[basis[r]])
+                        sum.add_product(costs[basis[r]],binv[r*m+k]);
+                y[k] = sum.value();
+            }
+            // Pick a variable to enter
+            int enter = -1;
+            rational best;
+            for (size_t p = 0; p < nonbasis.size(); p++) {
+                const rational d = reduced(costs,y,nonbasis[p]);
+                if (d.n<0 && (enter<0 || (bland?nonbasis[p]<nonbasis[enter]:d<best))) {
+                    enter = p;
+                    best = d;
+                }
+            }
+            if (enter<0)
+                return true;
+            // Pick a variable to leave
+            const int j = nonbasis[enter];
+            int leave = -1;
+            for (int r = 0; r < m; r++) {
+                u[r] = tableau(r,j);
+                if (u[r].n<=0)
+                    continue;
+                const int c = leave<0?-1:compare_ratios(xb[r],u[r],xb[leave],u[leave]);
+                if (c<0 || (!c && bland && basis[r]<basis[leave]))
+                    leave = r;
+            }
+            if (leave<0)
+                return false;
+            if (xb[leave].n) {
+                degenerate.clear();
+                cycling = false;
+            } else if (!this->bland && !cycling) {
+                std::vector<int> state(basis);
+                state.insert(state.end(),nonbasis.begin(),nonbasis.end());
+                cycling = !degenerate.insert(state).second;
+                if (cycling)
+                    continue; // Choose again with Bland's rule
+            }
+            pivot(leave,u);
+            swap(basis[leave],nonbasis[enter]);
+        }
+    }
+
+    // Start from the basis of artificial variables
+    void reset() {
+        std::fill(binv.begin(),binv.end(),rational());
+        xb = b;
+        for (int i = 0; i < m; i++) {
+            binv[i*m+i] = 1;
+            basis[i] = n+i;
+        }
+        nonbasis.resize(n);
+        for (int j = 0; j < n; j++)
+            nonbasis[j] = j;
+    }
+
+    // Pivot the structural variables of a previous basis in, replacing artificial variables.  Returns false if the
+    // result isn't feasible, since only phase 1 can remove nonzero artificial variables.
+    bool load_basis(const std::vector<int>& warm) {
+        reset();
+        std::vector<rational> u(m);
+        for (size_t t = 0; t < warm.size(); t++) {
+            const int p = std::find(nonbasis.begin(),nonbasis.end(),warm[t])-nonbasis.begin();
+            if (warm[t]>=n || p==int(nonbasis.size()))
+                continue;
+            tableau(warm[t],u);
+            for (int r = 0; r < m; r++)
+                if (basis[r]>=n && u[r]) {
+                    pivot(r,u);
+                    swap(basis[r],nonbasis[p]);
+                    break;
+                }
+        }
+        for (int r = 0; r < m; r++)
+            if (xb[r].n<0 || (basis[r]>=n && xb[r].n))
+                return false;
+        return true;
+    }
+
+public:
+    // A is m by n row major
+    simplex_solver(int m, int n, const rational* A, const rational* b_, bool bland)
+        :m(m),n(n),bland(bland),columns(n),b(b_,b_+m),binv(m*m),basis(m),pivots(0) {
+        for (int i = 0; i < m; i++) {
+            // Flip rows so that b >= 0 and the artificial basis is feasible
+            const bool flip = b[i].n<0;
+            if (flip)
+                b[i] = -b[i];
+            for (int j = 0; j < n; j++)
+                if (A[i*n+j]) {
+                    entry e = {i,flip?-A[i*n+j]:A[i*n+j]};
+                    columns[j].push_back(e);
+                }
+        }
+    }
+
+    // Solve, optionally starting from the basis of a similar problem
+    simplex_result solve(const rational* c, const std::vector<int>* warm=0) {
+        simplex_result result;
+        result.pivots = 0;
+        std::vector<rational> costs(n+m);
+        bool feasible = false;
+        if (warm) {
+            // An overflow here doesn't mean the cold start will overflow
+            try {
+                feasible = load_basis(*warm);
+            } catch (const overflow&) {}
+        }
+        if (!feasible) {
+            // Phase 1: minimize the sum of the artificial variables
+            reset();
+            for (int i = 0; i < m; i++)
+                costs[n+i] = 1;
+            if (!optimize(costs)) // Can't happen, since the sum is bounded below
+                throw std::logic_error("unbounded phase 1");
+            for (int r = 0; r < m; r++)
+                if (basis[r]>=n && xb[r].n) {
+                    result.status = simplex_result::infeasible;
+                    result.pivots = pivots;
+                    return result;
+                }
+        }
+        // Pivot zero artificial variables out of the basis where possible.  Any left over belong to redundant rows, so
+        // they stay zero.
+        std::vector<rational> u(m);
+        for (int r = 0; r < m; r++)
+            if (basis[r]>=n)
+                for (size_t p = 0; p < nonbasis.size(); p++)
+                    if (nonbasis[p]<n && tableau(r,nonbasis[p])) {
+                        tableau(nonbasis[p],u);
+                        pivot(r,u);
+                        swap(basis[r],nonbasis[p]);
+                        break;
+                    }
+        // Phase 2: drop the artificial variables and optimize c
+        std::vector<int> structural;
+        for (size_t p = 0; p < nonbasis.size(); p++)
+            if (nonbasis[p]<n)
+                structural.push_back(nonbasis[p]);
+        nonbasis.swap(structural);
+        for (int j = 0; j < n; j++)
+            costs[j] = c[j];
+        for (int i = 0; i < m; i++)
+            costs[n+i] = 0;
+        if (!optimize(costs)) {
+            result.status = simplex_result::unbounded;
+            result.basis = basis;
+            result.pivots = pivots;
+            return result;
+        }
+        result.status = simplex_result::optimal;
+        result.basis = basis;
+        result.pivots = pivots;
+        result.x.resize(n);
+        accumulator value;
+        for (int r = 0; r < m; r++)
+            if (basis[r]<n) {
+                result.x[basis[r]] = xb[r];
+                value.add_product(c[basis[r]],xb[r]);
+            }
+        result.value = value.value();
+        return result;
+    }
+};
+
+// Compressed sparse row matrices
+//
+// scipy.sparse doesn't support user dtypes, so exact sparse linear algebra needs its own CSR matrix.  Row i holds the
+// entries offsets[i] <= e < offsets[i+1], sorted by column and all nonzero.  As in matmul, each entry of a product is
+// summed in an accumulator.
+
+struct sparse_matrix {
+    int64_t m, n;
+    std::vector<int64_t> offsets, columns;
+    std::vector<rational> values;
+
+    sparse_matrix(int64_t m, int64_t n)
+        :m(m),n(n),offsets(m+1) {}
+
+    int64_t nnz() const {
+        return columns.size();
+    }
+
+    // From a dense row major array
+    static sparse_matrix from_dense(int64_t m, int64_t n, const rational* A) {
+        sparse_matrix S(m,n);
+        for (int64_t i = 0; i < m; i++) {
+            for (int64_t j = 0; j < n; j++)
+                if (A[i*n+j])
+                    S.push(j,A[i*n+j]);
+            S.offsets[i+1] = S.nnz();
+        }
+        return S;
+    }
+
+    // From coordinates (rows[e],cols[e],values[e]), summing duplicates and dropping zeros.  Indices must be in range.
+    static sparse_matrix from_coordinates(int64_t m, int64_t n, int64_t count, const int64_t* rows, const int64_t* cols, const rational* values) {
+        // Sort by column, then stably by row
+        const std::vector<int64_t> by_column = bucket(n,count,cols,0), order = bucket(m,count,rows,count?&by_column[0]:0);
+        sparse_matrix S(m,n);
+        for (int64_t t = 0; t < count;) {
+            const int64_t i = rows[order[t]], j = cols[order[t]];
+            accumulator sum;
+            for (; t < count && rows[order[t]]==i && cols[order[t]]==j; t++)
+                sum.add(values[order[t]]);
+            S.push(j,sum.value());
+            S.offsets[i+1] = S.nnz();
+        }
+        for (int64_t i = 0; i < m; i++) // Fill in empty rows
+            S.offsets[i+1] = max(S.offsets[i+1],S.offsets[i]);
+        return S;
+    }
+
+    void to_dense(rational* A) const {
+        std::fill(A,A+m*n,rational());
+        for (int64_t i = 0; i < m; i++)
+            for (int64_t e = offsets[i]; e < offsets[i+1]; e++)
+                A[i*n+columns[e]] = values[e];
+    }
+
+    sparse_matrix transpose() const {
+        sparse_matrix T(n,m);
+        for (int64_t e = 0; e < nnz(); e++)
+            T.offsets[columns[e]+1]++;
+        for (int64_t j = 0; j < n; j++)
+            T.offsets[j+1] += T.offsets[j];
+        T.columns.resize(nnz());
+        T.values.resize(nnz());
+        std::vector<int64_t> next(T.offsets.begin(),T.offsets.end()-1);
+        for (int64_t i = 0; i < m; i++)
+            for (int64_t e = offsets[i]; e < offsets[i+1]; e++) {
+                const int64_t f = next[columns[e]]++;
+                T.columns[f] = i;
+                T.values[f] = values[e];
+            }
+        return T;
+    }
+
+    // y = Ax
+    void multiply(const rational* x, rational* y) const {
+        for (int64_t i = 0; i < m; i++) {
+            accumulator sum;
+            for (int64_t e = offsets[i]; e < offsets[i+1]; e++)
+                if (x[columns[e]])
+                    sum.add_product(values[e],x[columns[e]]);
+            y[i] = sum.value();
+        }
+    }
+
+    // Y = AX for dense row major X with p columns
+    void multiply(int64_t p, const rational* X, rational* Y) const {
+        std::vector<accumulator> sums;
+        for (int64_t i = 0; i < m; i++) {
+            sums.assign(p,accumulator());
+            for (int64_t e = offsets[i]; e < offsets[i+1]; e++) {
+                const rational* x = X+columns[e]*p;
+                for (int64_t k = 0; k < p; k++)
+                    if (x[k])
+                        sums[k].add_product(values[e],x[k]);
+            }
+            for (int64_t k = 0; k < p; k++)
+                Y[i*p+k] = sums[k].value();
+        }
+    }
+
+    // AB, one row at a time with a dense accumulator per column of B (Gustavson's algorithm)
+    sparse_matrix operator*(const sparse_matrix& B) const {
+        sparse_matrix C(m,B.n);
+        std::vector<accumulator> sums(B.n);
+        std::vector<int64_t> seen(B.n,-1), pattern;
+        for (int64_t i = 0; i < m; i++) {
+            pattern.clear();
+            for (int64_t e = offsets[i]; e < offsets[i+1]; e++) {
+                const int64_t j = columns[e];
+                for (int64_t f = B.offsets[j]; f < B.offsets[j+1]; f++) {
+                    const int64_t k = B.columns[f];
+                    if (seen[k]!=i) {
+                        seen[k] = i;
+                        sums[k] = accumulator();
+                        pattern.push_back(k);
+                    }
+                    sums[k].add_product(values[e],B.values[f]);
+                }
+            }
+            std::sort(pattern.begin(),pattern.end());
+            for (size_t t = 0; t < pattern.size(); t++)
+                C.push(pattern[t],sums[pattern[t]].value());
+            C.offsets[i+1] = C.nnz();
+        }
+        return C;
+    }
+
+private:
+    void push(int64_t j, rational v) {
+        if (v) {
+            columns.push_back(j);
+            values.push_back(v);
+        }
+    }
+
+    // Stable counting sort of order (or 0..count-1 if order is null) by keys in [0,k)
+    static std::vector<int64_t> bucket(int64_t k, int64_t count, const int64_t* keys, const int64_t* order) {
+        std::vector<int64_t> start(k+1), sorted(count);
+        for (int64_t e = 0; e < count; e++)
+            start[keys[e]+1]++;
+        for (int64_t j = 0; j < k; j++)
+            start[j+1] += start[j];
+        for (int64_t t = 0; t < count; t++) {
+            const int64_t e = order?order[t]:t;
+            sorted[start[keys[e]]++] = e;
+        }
+        return sorted;
+    }
+};
+
 // Conversion from C++ to Python exceptions
 
-void set_python_error(const exception& e) {
+void set_python_error(const type_info& type, const char* what) {
     // Numpy will call us without access to the Python API, so we need to grab it before setting an error
     PyGILState_STATE state = PyGILState_Ensure();
-    const type_info& type = typeid(e);
     if (type==typeid(overflow))
         PyErr_SetString(PyExc_OverflowError,"overflow in rational arithmetic");
     else if (type==typeid(zero_divide))
         PyErr_SetString(PyExc_ZeroDivisionError,"zero divide in rational arithmetic");
     else
-        PyErr_Format(PyExc_RuntimeError,"unknown exception %s: %s",type.name(),e.what());
+        PyErr_Format(PyExc_RuntimeError,"unknown exception %s: %s",type.name(),what);
     PyGILState_Release(state);
 }
 
+void set_python_error(const exception& e) {
+    set_python_error(typeid(e),e.what());
+}
+
 // Expose rational to Python as a numpy scalar
 
 typedef struct {
@@ -325,6 +930,31 @@ PyObject* PyRational_FromRational(rational x) {
     return (PyObject*)p;
 }
 
+// Convert objects other than ints with integer numerator and denominator attributes, such as fractions.Fraction.
+// Returns 1 on success, 0 if object doesn't look like a fraction, or -1 with a Python exception set.
+int fraction_to_rational(PyObject* object, rational& r) {
+    if (PyInt_Check(object) || PyLong_Check(object) || !PyObject_HasAttrString(object,"numerator") || !PyObject_HasAttrString(object,"denominator"))
+        return 0;
+    const char* names[2] = {"numerator","denominator"};
+    long n[2];
+    for (int i = 0; i < 2; i++) {
+        PyObject* x = PyObject_GetAttrString(object,names[i]);
+        if (!x)
+            return -1;
+        n[i] = PyInt_AsLong(x); // Raises OverflowError if x doesn't fit
+        Py_DECREF(x);
+        if (n[i]==-1 && PyErr_Occurred())
+            return -1;
+    }
+    try {
+        r = rational(n[0],n[1]);
+    } catch (const exception& e) {
+        set_python_error(e);
+        return -1;
+    }
+    return 1;
+}
+
 PyObject* rational_new(PyTypeObject* type, PyObject* args, PyObject* kwds) {
     if (kwds && PyDict_Size(kwds)) {
         PyErr_SetString(PyExc_TypeError,"constructor takes no keyword arguments");
@@ -353,6 +983,9 @@ PyObject* rational_new(PyTypeObject* type, PyObject* args, PyObject* kwds) {
             PyErr_Format(PyExc_ValueError,"invalid rational literal '%s'",s);
             return 0;
         }
+        rational r;
+        if (int found = fraction_to_rational(x[0],r))
+            return found<0?0:PyRational_FromRational(r);
     }
     long n[2]={0,1};
     for (int i=0;i<size;i++) {
@@ -557,6 +1190,9 @@ PyObject* rational_d(PyObject* self, void* closure) {
 PyGetSetDef rational_getset[] = {
     {(char*)"n",rational_n,0,(char*)"numerator",0},
     {(char*)"d",rational_d,0,(char*)"denominator",0},
+    // Same as fractions.Fraction, so code can handle both
+    {(char*)"numerator",rational_n,0,(char*)"numerator",0},
+    {(char*)"denominator",rational_d,0,(char*)"denominator",0},
     {0} // sentinel
 };
 
@@ -615,7 +1251,10 @@ int rational_setitem(PyObject* item, void* data, void* arr) {
     rational r;
     if (PyRational_Check(item))
         r = ((PyRational*)item)->r;
-    else {
+    else if (int found = fraction_to_rational(item,r)) {
+        if (found<0)
+            return -1;
+    } else {
         long n = PyInt_AsLong(item);
         if (n==-1 && PyErr_Occurred())
             return -1;
@@ -642,29 +1281,30 @@ template<class T> inline void byteswap(T& x) {
         swap(p[i],p[sizeof(T)-1-i]);
 }
 
-void rational_copyswapn(void* dst_, npy_intp dstride, void* src_, npy_intp sstride, npy_intp n, int swap, void* arr) {
+// R is rational or rational32
+template<class R> void rational_copyswapn(void* dst_, npy_intp dstride, void* src_, npy_intp sstride, npy_intp n, int swap, void* arr) {
     char *dst = (char*)dst_, *src = (char*)src_;
     if (!src)
         return;
     if (swap)
         for (npy_intp i = 0; i < n; i++) {
-            rational& r = *(rational*)(dst+dstride*i);
-            memcpy(&r,src+sstride*i,sizeof(rational));
+            R& r = *(R*)(dst+dstride*i);
+            memcpy(&r,src+sstride*i,sizeof(R));
             byteswap(r.n);
             byteswap(r.dmm);
         }
-    else if (dstride==sizeof(rational) && sstride==sizeof(rational))
-        memcpy(dst,src,n*sizeof(rational));
+    else if (dstride==sizeof(R) && sstride==sizeof(R))
+        memcpy(dst,src,n*sizeof(R));
     else
         for (npy_intp i = 0; i < n; i++)
-            memcpy(dst+dstride*i,src+sstride*i,sizeof(rational));
+            memcpy(dst+dstride*i,src+sstride*i,sizeof(R));
 }
 
-void rational_copyswap(void* dst, void* src, int swap, void* arr) {
+template<class R> void rational_copyswap(void* dst, void* src, int swap, void* arr) {
     if (!src)
         return;
-    rational& r = *(rational*)dst;
-    memcpy(&r,src,sizeof(rational));
+    R& r = *(R*)dst;
+    memcpy(&r,src,sizeof(R));
     if (swap) {
         byteswap(r.n);
         byteswap(r.dmm);
@@ -696,15 +1336,15 @@ FIND_EXTREME(argmin,<)
 FIND_EXTREME(argmax,>)
 
 void rational_dot(void* ip0_, npy_intp is0, void* ip1_, npy_intp is1, void* op, npy_intp n, void* arr) {
-    rational r;
+    accumulator sum;
     try {
         const char *ip0 = (char*)ip0_, *ip1 = (char*)ip1_;
         for (npy_intp i = 0; i < n; i++) {
-            r = r + (*(rational*)ip0)*(*(rational*)ip1);
+            sum.add_product(*(rational*)ip0,*(rational*)ip1);
             ip0 += is0;
             ip1 += is1;
         }
-        *(rational*)op = r;
+        *(rational*)op = sum.value();
     } catch (const exception& e) {
         set_python_error(e);
     }
@@ -761,6 +1401,190 @@ PyArray_Descr rational_descr = {
     &rational_arrfuncs,     // f
 };
 
+// Numpy support for rational32
+//
+// rational32 scalars are rationals that happen to fit in 32 bits, so scalar arithmetic gives ordinary rationals.  Arrays
+// convert to rational as they're read: the rational ufunc loops are registered for rational32 as well, and the safe
+// rational32 -> rational cast lets numpy widen the inputs a buffer at a time.
+
+extern PyTypeObject PyRational32_Type;
+
+PyObject* PyRational32_FromRational(rational x) {
+    PyRational* p = (PyRational*)PyRational32_Type.tp_alloc(&PyRational32_Type,0);
+    if (p)
+        p->r = x;
+    return (PyObject*)p;
+}
+
+PyObject* rational32_new(PyTypeObject* type, PyObject* args, PyObject* kwds) {
+    PyObject* x = rational_new(&PyRational_Type,args,kwds);
+    if (!x)
+        return 0;
+    const rational r = ((PyRational*)x)->r;
+    Py_DECREF(x);
+    try {
+        cast<rational32>(r);
+    } catch (const exception& e) {
+        set_python_error(e);
+        return 0;
+    }
+    return PyRational32_FromRational(r);
+}
+
+PyTypeObject PyRational32_Type = {
+    PyObject_HEAD_INIT(&PyType_Type)
+    0,                                        // ob_size
+    "rational32",                             // tp_name
+    sizeof(PyRational),                       // tp_basicsize
+    0,                                        // tp_itemsize
+    0,                                        // tp_dealloc
+    0,                                        // tp_print
+    0,                                        // tp_getattr
+    0,                                        // tp_setattr
+    0,                                        // tp_compare
+    0,                                        // tp_repr
+    0,                                        // tp_as_number
+    0,                                        // tp_as_sequence
+    0,                                        // tp_as_mapping
+    0,                                        // tp_hash
+    0,                                        // tp_call
+    0,                                        // tp_str
+    0,                                        // tp_getattro
+    0,                                        // tp_setattro
+    0,                                        // tp_as_buffer
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_CHECKTYPES, // tp_flags
+    "Rational numbers with 32-bit numerator and denominator", // tp_doc
+    0,                                        // tp_traverse
+    0,                                        // tp_clear
+    0,                                        // tp_richcompare
+    0,                                        // tp_weaklistoffset
+    0,                                        // tp_iter
+    0,                                        // tp_iternext
+    0,                                        // tp_methods
+    0,                                        // tp_members
+    0,                                        // tp_getset
+    0,                                        // tp_base
+    0,                                        // tp_dict
+    0,                                        // tp_descr_get
+    0,                                        // tp_descr_set
+    0,                                        // tp_dictoffset
+    0,                                        // tp_init
+    0,                                        // tp_alloc
+    rational32_new,                           // tp_new
+    0,                                        // tp_free
+};
+
+PyObject* rational32_getitem(void* data, void* arr) {
+    rational32 r;
+    memcpy(&r,data,sizeof(rational32));
+    return PyRational32_FromRational(cast<rational>(r));
+}
+
+int rational32_setitem(PyObject* item, void* data, void* arr) {
+    rational r;
+    if (rational_setitem(item,&r,arr)<0)
+        return -1;
+    try {
+        const rational32 s = cast<rational32>(r);
+        memcpy(data,&s,sizeof(rational32));
+    } catch (const exception& e) {
+        set_python_error(e);
+        return -1;
+    }
+    return 0;
+}
+
+int rational32_compare(const void* d0, const void* d1, void* arr) {
+    const rational x = cast<rational>(*(rational32*)d0),
+                   y = cast<rational>(*(rational32*)d1);
+    return x<y?-1:x==y?0:1;
+}
+
+npy_bool rational32_nonzero(void* data, void* arr) {
+    rational32 r;
+    memcpy(&r,data,sizeof(r));
+    return r.n?NPY_TRUE:NPY_FALSE;
+}
+
+#define FIND_EXTREME32(name,op) \
+    int rational32_##name(void* data_, npy_intp n, npy_intp* max_ind, void* arr) { \
+        if (!n) \
+            return 0; \
+        const rational32* data = (rational32*)data_; \
+        npy_intp best_i = 0; \
+        rational best_r = cast<rational>(data[0]); \
+        for (npy_intp i = 1; i < n; i++) { \
+            const rational r = cast<rational>(data[i]); \
+            if (r op best_r) { \
+                best_i = i; \
+                best_r = r; \
+            } \
+        } \
+        *max_ind = best_i; \
+        return 0; \
+    }
+FIND_EXTREME32(argmin,<)
+FIND_EXTREME32(argmax,>)
+
+// Products are summed in a rational accumulator, and only the result is narrowed
+void rational32_dot(void* ip0_, npy_intp is0, void* ip1_, npy_intp is1, void* op, npy_intp n, void* arr) {
+    accumulator sum;
+    try {
+        const char *ip0 = (char*)ip0_, *ip1 = (char*)ip1_;
+        for (npy_intp i = 0; i < n; i++) {
+            sum.add_product(cast<rational>(*(rational32*)ip0),cast<rational>(*(rational32*)ip1));
+            ip0 += is0;
+            ip1 += is1;
+        }
+        *(rational32*)op = cast<rational32>(sum.value());
+    } catch (const exception& e) {
+        set_python_error(e);
+    }
+}
+
+int rational32_fill(void* data_, npy_intp length, void* arr) {
+    rational32* data = (rational32*)data_;
+    try {
+        const rational delta = cast<rational>(data[1])-cast<rational>(data[0]);
+        rational r = cast<rational>(data[1]);
+        for (npy_intp i = 2; i < length; i++) {
+            r = r+delta;
+            data[i] = cast<rational32>(r);
+        }
+    } catch (const exception& e) {
+        set_python_error(e);
+    }
+    return 0;
+}
+
+int rational32_fillwithscalar(void* buffer_, npy_intp length, void* value, void* arr) {
+    rational32 r = *(rational32*)value;
+    rational32* buffer = (rational32*)buffer_;
+    for (npy_intp i = 0; i < length; i++)
+        buffer[i] = r;
+    return 0;
+}
+
+PyArray_ArrFuncs rational32_arrfuncs;
+
+struct align_test32 { char c; struct {int32_t i[2];} r; };
+
+PyArray_Descr rational32_descr = {
+    PyObject_HEAD_INIT(0)
+    &PyRational32_Type,     // typeobj
+    'V',                    // kind
+    'R',                    // type
+    '=',                    // byteorder
+    NPY_NEEDS_PYAPI | NPY_USE_GETITEM | NPY_USE_SETITEM, // hasobject (see rational_descr)
+    0,                      // type_num
+    sizeof(rational32),     // elsize
+    offsetof(align_test32,r), // alignment
+    0,                      // subarray
+    0,                      // fields
+    0,                      // names
+    &rational32_arrfuncs,   // f
+};
+
 template<class From,class To> void numpy_cast(void* from_, void* to_, npy_intp n, void* fromarr, void* toarr) {
     const From* from = (From*)from_;
     To* to = (To*)to_;
@@ -795,7 +1619,28 @@ template<class From,class To> int register_cast(PyArray_Descr* from_descr, int t
         } \
     }
 #define RATIONAL_BINARY_UFUNC(name,type,exp) BINARY_UFUNC(rational_ufunc_##name,rational,rational,type,exp)
-RATIONAL_BINARY_UFUNC(add,rational,x+y)
+RATIONAL_BINARY_UFUNC(add_pairwise,rational,x+y)
+// add.reduce calls the add loop with the output aliasing the first input at zero stride.  In that case, sum into an
+// accumulator so that we reduce once at the end instead of after every term.
+void rational_ufunc_add(char** args, npy_intp* dimensions, npy_intp* steps, void* data) {
+    if (!(args[0]==args[2] && !steps[0] && !steps[2])) {
+        rational_ufunc_add_pairwise(args,dimensions,steps,data);
+        return;
+    }
+    const npy_intp is = steps[1], n = *dimensions;
+    const char* i = args[1];
+    try {
+        accumulator sum;
+        sum.add(*(rational*)args[0]);
+        for (npy_intp k = 0; k < n; k++) {
+            sum.add(*(rational*)i);
+            i += is;
+        }
+        *(rational*)args[2] = sum.value();
+    } catch (const exception& e) {
+        set_python_error(e);
+    }
+}
 RATIONAL_BINARY_UFUNC(subtract,rational,x-y)
 RATIONAL_BINARY_UFUNC(multiply,rational,x*y)
 RATIONAL_BINARY_UFUNC(divide,rational,x/y)
@@ -840,7 +1685,603 @@ UNARY_UFUNC(reciprocal,rational,inverse(x))
 UNARY_UFUNC(numerator,int64_t,x.n)
 UNARY_UFUNC(denominator,int64_t,x.d())
 
+// Matrix multiplication
+//
+// numpy.dot on user types computes each output entry as a separate strided inner product, so we provide a matmul gufunc
+// with signature (m,n),(n,p)->(m,p).  Rows of the output are independent and run in parallel.  Within a row, each entry
+// is an accumulator, and we sweep blocks of n and p so that the active accumulators and the touched tile of B stay in
+// cache.  Zero entries of A are skipped, which helps the mostly zero payoff and tableau matrices we multiply.
+
+const npy_intp matmul_block_n = 128, matmul_block_p = 64;
+
+struct matrix_view {
+    char* data;
+    npy_intp s0, s1;
+
+    rational& operator()(npy_intp i, npy_intp j) const {
+        return *(rational*)(data+s0*i+s1*j);
+    }
+};
+
+void rational_matmul_row(const matrix_view& A, const matrix_view& B, const matrix_view& C, npy_intp i, npy_intp n, npy_intp p, std::vector<accumulator>& sums) {
+    sums.assign(p,accumulator());
+    for (npy_intp k0 = 0; k0 < n; k0 += matmul_block_n) {
+        const npy_intp k1 = min(n,k0+matmul_block_n);
+        for (npy_intp j0 = 0; j0 < p; j0 += matmul_block_p) {
+            const npy_intp j1 = min(p,j0+matmul_block_p);
+            for (npy_intp k = k0; k < k1; k++) {
+                const rational a = A(i,k);
+                if (!a.n)
+                    continue;
+                for (npy_intp j = j0; j < j1; j++) {
+                    const rational b = B(k,j);
+                    if (b.n)
+                        sums[j].add_product(a,b);
+                }
+            }
+        }
+    }
+    for (npy_intp j = 0; j < p; j++)
+        C(i,j) = sums[j].value();
+}
+
+void rational_ufunc_matmul(char** args, npy_intp* dimensions, npy_intp* steps, void* data) {
+    const npy_intp N = dimensions[0], m = dimensions[1], n = dimensions[2], p = dimensions[3];
+    const type_info* error = 0;
+    std::string what;
+    for (npy_intp t = 0; t < N && !error; t++) {
+        const matrix_view A = {args[0]+t*steps[0],steps[3],steps[4]},
+                          B = {args[1]+t*steps[1],steps[5],steps[6]},
+                          C = {args[2]+t*steps[2],steps[7],steps[8]};
+        // Only spin up threads if there's enough work to pay for them
+        #pragma omp parallel if(m>1 && m*n*p>=(1<<15))
+        {
+            std::vector<accumulator> sums;
+            #pragma omp for schedule(dynamic)
+            for (npy_intp i = 0; i < m; i++) {
+                // Other threads may set error at any time, so read it under the same lock
+                bool stop;
+                #pragma omp critical
+                stop = error!=0;
+                if (stop)
+                    continue;
+                try {
+                    rational_matmul_row(A,B,C,i,n,p,sums);
+                } catch (const exception& e) {
+                    #pragma omp critical
+                    {
+                        if (!error) {
+                            error = &typeid(e);
+                            what = e.what();
+                        }
+                    }
+                }
+            }
+        }
+    }
+    // Numpy holds the GIL while it waits for us, so worker threads can't grab it.  Report through the calling thread.
+    if (error)
+        set_python_error(*error,what.c_str());
+}
+
+// Simplex ratio test
+//
+// argmin_ratio(a,b) finds the first index minimizing a[i]/b[i] over b[i] > 0, the leaving variable choice of the simplex
+// method.  In numpy this means a division per entry, each with a 128-bit gcd, and comparing unreduced ratios exactly
+// takes 256-bit products.  Instead we compare double approximations, computed a block at a time so the compiler can
+// vectorize them, and fall back to exact comparison (compare_products) only when two ratios are too close to call.
+// Exact 64-bit comparisons are a pair of widening multiplies, so plain comparisons and argmin/argmax gain nothing.
+
+const int ratio_block = 64;
+
+void rational_ufunc_argmin_ratio(char** args, npy_intp* dimensions, npy_intp* steps, void* data) {
+    typedef rational::DI DI;
+    const npy_intp N = dimensions[0], n = dimensions[1], as = steps[3], bs = steps[4];
+    for (npy_intp t = 0; t < N; t++) {
+        const char *a = args[0]+t*steps[0], *b = args[1]+t*steps[1];
+        npy_intp best = -1;
+        double best_ratio = 0;
+        DI best_p = 0; // a[best]/b[best] = best_p/best_q, unreduced
+        uint128_t best_q = 1;
+        for (npy_intp i0 = 0; i0 < n; i0 += ratio_block) {
+            const int len = min(n-i0,npy_intp(ratio_block));
+            // Each ratio takes seven correctly rounded operations, so its relative error is under 2^-50.  Entries
+            // with b[i] <= 0 are skipped below, but dividing by them would still raise floating point flags that numpy
+            // reports after the loop, so they divide by one instead.
+            double ratios[ratio_block];
+            for (int l = 0; l < len; l++) {
+                const rational x = *(const rational*)(a+as*(i0+l)),
+                               y = *(const rational*)(b+bs*(i0+l));
+                const double q = double(x.d())*double(y.n);
+                ratios[l] = (double(x.n)*double(y.d()))/(y.n>0?q:1.);
+            }
+            for (int l = 0; l < len; l++) {
+                const rational x = *(const rational*)(a+as*(i0+l)),
+                               y = *(const rational*)(b+bs*(i0+l));
+                if (y.n<=0)
+                    continue;
+                const double r = ratios[l];
+                if (best>=0) {
+                    const double margin = 0x1p-48*(fabs(r)+fabs(best_ratio));
+                    if (r>=best_ratio+margin)
+                        continue;
+                    const DI p = DI(x.n)*y.d();
+                    const uint128_t q = DI(x.d())*y.n;
+                    if (r>best_ratio-margin && compare_products(p,best_q,best_p,q)>=0) // too close to call
+                        continue;
+                }
+                best = i0+l;
+                best_ratio = r;
+                best_p = DI(x.n)*y.d();
+                best_q = DI(x.d())*y.n;
+            }
+        }
+        *(npy_intp*)(args[2]+t*steps[2]) = best;
+    }
+}
+
+// Time Euclid's gcd against binary_gcd on random 128-bit products, as used by rational arithmetic
+PyObject* benchmark_gcd(PyObject* self, PyObject* args) {
+    long count;
+    if (!PyArg_ParseTuple(args,"l",&count))
+        return 0;
+    std::vector<int128_t> x(max(count,0L)), y(x.size());
+    uint64_t s = 88172645463325252ULL;
+    for (size_t i = 0; i < x.size(); i++) {
+        int64_t r[4];
+        for (int j = 0; j < 4; j++) {
+            s ^= s<<13; s ^= s>>7; s ^= s<<17; // xorshift64
+            r[j] = s>>1;
+        }
+        x[i] = int128_t(r[0])*r[1];
+        y[i] = int128_t(r[2])*r[3];
+    }
+    int128_t sums[2] = {0,0};
+    double times[2];
+    for (int k = 0; k < 2; k++) {
+        const clock_t start = clock();
+        for (size_t i = 0; i < x.size(); i++)
+            sums[k] += k?binary_gcd(x[i],y[i]):euclid_gcd(x[i],y[i]);
+        times[k] = double(clock()-start)/CLOCKS_PER_SEC;
+    }
+    bool same = sums[0]==sums[1];
+    for (size_t i = 0; i < x.size(); i++)
+        same = same && euclid_gcd(x[i],y[i])==binary_gcd(x[i],y[i]);
+    if (!same) {
+        PyErr_SetString(PyExc_AssertionError,"euclid_gcd and binary_gcd disagree");
+        return 0;
+    }
+    return Py_BuildValue("dd",times[0],times[1]);
+}
+
+// Convert to a contiguous rational array with between min_ndim and max_ndim dimensions
+PyArrayObject* rational_array(PyObject* object, int min_ndim, int max_ndim) {
+    Py_INCREF(&rational_descr); // PyArray_FromAny steals a reference
+    return (PyArrayObject*)PyArray_FromAny(object,&rational_descr,min_ndim,max_ndim,NPY_ARRAY_IN_ARRAY,0);
+}
+
+// New uninitialized contiguous rational array
+PyArrayObject* new_rational_array(int ndim, npy_intp* dims) {
+    Py_INCREF(&rational_descr);
+    return (PyArrayObject*)PyArray_NewFromDescr(&PyArray_Type,&rational_descr,ndim,dims,0,0,0,0);
+}
+
+// Solve an LP exactly with simplex_solver, returning (status,value,x)
+PyObject* simplex(PyObject* self, PyObject* args) {
+    PyObject *c_, *A_, *b_;
+    int bland = 0;
+    if (!PyArg_ParseTuple(args,"OOO|i",&c_,&A_,&b_,&bland))
+        return 0;
+    PyObject* arrays[3] = {c_,A_,b_};
+    const int ndims[3] = {1,2,1};
+    for (int k = 0; k < 3; k++) {
+        arrays[k] = (PyObject*)rational_array(arrays[k],ndims[k],ndims[k]);
+        if (!arrays[k]) {
+            for (int j = 0; j < k; j++)
+                Py_DECREF(arrays[j]);
+            return 0;
+        }
+    }
+    PyArrayObject *c = (PyArrayObject*)arrays[0], *A = (PyArrayObject*)arrays[1], *b = (PyArrayObject*)arrays[2];
+    const npy_intp m = PyArray_DIM(A,0), n = PyArray_DIM(A,1);
+    PyObject* result = 0;
+    if (PyArray_DIM(c,0)!=n || PyArray_DIM(b,0)!=m)
+        PyErr_Format(PyExc_ValueError,"simplex: expected c, A, b of shapes (n,), (m,n), (m,), got (%ld,), (%ld,%ld), (%ld,)",
+            long(PyArray_DIM(c,0)),long(m),long(n),long(PyArray_DIM(b,0)));
+    else {
+        simplex_result r;
+        bool failed = false;
+        Py_BEGIN_ALLOW_THREADS
+        try {
+            r = simplex_solver(m,n,(const rational*)PyArray_DATA(A),(const rational*)PyArray_DATA(b),bland!=0)
+                .solve((const rational*)PyArray_DATA(c));
+        } catch (const exception& e) {
+            set_python_error(e);
+            failed = true;
+        }
+        Py_END_ALLOW_THREADS
+        if (!failed) {
+            if (r.status!=simplex_result::optimal)
+                result = Py_BuildValue("sOO",r.status==simplex_result::unbounded?"unbounded":"infeasible",Py_None,Py_None);
+            else {
+                npy_intp size = n;
+                PyObject* x = (PyObject*)new_rational_array(1,&size);
+                PyObject* value = PyRational_FromRational(r.value);
+                if (x && value) {
+                    if (n)
+                        std::copy(r.x.begin(),r.x.end(),(rational*)PyArray_DATA((PyArrayObject*)x));
+                    result = Py_BuildValue("sOO","optimal",value,x);
+                }
+                Py_XDECREF(x);
+                Py_XDECREF(value);
+            }
+        }
+    }
+    for (int k = 0; k < 3; k++)
+        Py_DECREF(arrays[k]);
+    return result;
+}
+
+// Solve a stack of LPs of the same shape, such as one per bet size.  Consecutive problems run in chunks so that each can
+// warm start from the previous problem's basis, and chunks run in parallel.  A problem that overflows gets status
+// 'overflow' rather than failing the whole batch, so callers can retry it with arbitrary precision.
+
+const npy_intp simplex_batch_chunk = 8;
+
+PyObject* simplex_batch(PyObject* self, PyObject* args) {
+    PyObject *c_, *A_, *b_;
+    int bland = 0;
+    if (!PyArg_ParseTuple(args,"OOO|i",&c_,&A_,&b_,&bland))
+        return 0;
+    PyObject* arrays[3] = {c_,A_,b_};
+    const int ndims[3] = {2,3,2};
+    for (int k = 0; k < 3; k++) {
+        arrays[k] = (PyObject*)rational_array(arrays[k],ndims[k],ndims[k]);
+        if (!arrays[k]) {
+            for (int j = 0; j < k; j++)
+                Py_DECREF(arrays[j]);
+            return 0;
+        }
+    }
+    PyArrayObject *c = (PyArrayObject*)arrays[0], *A = (PyArrayObject*)arrays[1], *b = (PyArrayObject*)arrays[2];
+    const npy_intp count = PyArray_DIM(A,0), m = PyArray_DIM(A,1), n = PyArray_DIM(A,2);
+    PyObject* result = 0;
+    if (PyArray_DIM(c,0)!=count || PyArray_DIM(c,1)!=n || PyArray_DIM(b,0)!=count || PyArray_DIM(b,1)!=m)
+        PyErr_Format(PyExc_ValueError,"simplex_batch: expected c, A, b of shapes (k,n), (k,m,n), (k,m), got (%ld,%ld), (%ld,%ld,%ld), (%ld,%ld)",
+            long(PyArray_DIM(c,0)),long(PyArray_DIM(c,1)),long(count),long(m),long(n),long(PyArray_DIM(b,0)),long(PyArray_DIM(b,1)));
+    else {
+        std::vector<simplex_result> results(count);
+        std::vector<char> overflowed(count);
+        const type_info* error = 0;
+        Py_BEGIN_ALLOW_THREADS
+        const npy_intp chunks = (count+simplex_batch_chunk-1)/simplex_batch_chunk;
+        #pragma omp parallel for schedule(dynamic)
+        for (npy_intp t = 0; t < chunks; t++) {
+            const std::vector<int>* warm = 0;
+            for (npy_intp k = t*simplex_batch_chunk; k < min(count,(t+1)*simplex_batch_chunk); k++) {
+                bool stop;
+                #pragma omp critical
+                stop = error!=0;
+                if (stop)
+                    break;
+                try {
+                    results[k] = simplex_solver(m,n,(const rational*)PyArray_DATA(A)+k*m*n,(const rational*)PyArray_DATA(b)+k*m,bland!=0)
+                        .solve((const rational*)PyArray_DATA(c)+k*n,warm);
+                    warm = results[k].basis.size()?&results[k].basis:0;
+                } catch (const overflow&) {
+                    overflowed[k] = true;
+                    warm = 0;
+                } catch (const exception& e) {
+                    #pragma omp critical
+                    {
+                        if (!error)
+                            error = &typeid(e);
+                    }
+                }
+            }
+        }
+        Py_END_ALLOW_THREADS
+        if (error)
+            PyErr_Format(PyExc_RuntimeError,"unknown exception %s",error->name());
+        else if ((result = PyList_New(count))) {
+            for (npy_intp k = 0; k < count; k++) {
+                const simplex_result& r = results[k];
+                PyObject* item = 0;
+                if (overflowed[k])
+                    item = Py_BuildValue("sOOO","overflow",Py_None,Py_None,Py_None);
+                else if (r.status!=simplex_result::optimal)
+                    item = Py_BuildValue("sOOi",r.status==simplex_result::unbounded?"unbounded":"infeasible",Py_None,Py_None,r.pivots);
+                else {
+                    npy_intp size = n;
+                    PyObject* x = (PyObject*)new_rational_array(1,&size);
+                    PyObject* value = PyRational_FromRational(r.value);
+                    if (x && value) {
+                        if (n)
+                            std::copy(r.x.begin(),r.x.end(),(rational*)PyArray_DATA((PyArrayObject*)x));
+                        item = Py_BuildValue("sOOi","optimal",value,x,r.pivots);
+                    }
+                    Py_XDECREF(x);
+                    Py_XDECREF(value);
+                }
+                if (!item) {
+                    Py_CLEAR(result);
+                    break;
+                }
+                PyList_SET_ITEM(result,k,item);
+            }
+        }
+    }
+    for (int k = 0; k < 3; k++)
+        Py_DECREF(arrays[k]);
+    return result;
+}
+
+// Expose sparse_matrix to Python
+
+typedef struct {
+    PyObject_HEAD;
+    sparse_matrix* A;
+} PyRationalCSR;
+
+extern PyTypeObject PyRationalCSR_Type;
+
+inline bool PyRationalCSR_Check(PyObject* object) {
+    return PyObject_IsInstance(object,(PyObject*)&PyRationalCSR_Type);
+}
+
+inline const sparse_matrix& csr(PyObject* self) {
+    return *((PyRationalCSR*)self)->A;
+}
+
+PyObject* PyRationalCSR_FromMatrix(const sparse_matrix& A) {
+    PyRationalCSR* p = (PyRationalCSR*)PyRationalCSR_Type.tp_alloc(&PyRationalCSR_Type,0);
+    if (p) {
+        try {
+            p->A = new sparse_matrix(A);
+        } catch (const std::bad_alloc&) {
+            Py_DECREF(p);
+            return PyErr_NoMemory();
+        }
+    }
+    return (PyObject*)p;
+}
+
+// Convert to a contiguous int64 index array
+PyArrayObject* index_array(PyObject* object) {
+    return (PyArrayObject*)PyArray_FromAny(object,PyArray_DescrFromType(NPY_INT64),1,1,NPY_ARRAY_IN_ARRAY,0);
+}
+
+// rational_csr(A) for dense A, or rational_csr(data,rows,cols,(m,n)) for coordinates
+PyObject* csr_new(PyTypeObject* type, PyObject* args, PyObject* kwds) {
+    if (kwds && PyDict_Size(kwds)) {
+        PyErr_SetString(PyExc_TypeError,"constructor takes no keyword arguments");
+        return 0;
+    }
+    PyObject *data_, *rows_ = 0, *cols_ = 0;
+    long m = 0, n = 0;
+    if (PyTuple_GET_SIZE(args)==1) {
+        PyArrayObject* A = rational_array(PyTuple_GET_ITEM(args,0),2,2);
+        if (!A)
+            return 0;
+        PyObject* result = 0;
+        try {
+            result = PyRationalCSR_FromMatrix(sparse_matrix::from_dense(PyArray_DIM(A,0),PyArray_DIM(A,1),(const rational*)PyArray_DATA(A)));
+        } catch (const exception& e) {
+            set_python_error(e);
+        }
+        Py_DECREF(A);
+        return result;
+    }
+    if (!PyArg_ParseTuple(args,"OOO(ll)",&data_,&rows_,&cols_,&m,&n))
+        return 0;
+    if (m<0 || n<0) {
+        PyErr_Format(PyExc_ValueError,"rational_csr: invalid shape (%ld,%ld)",m,n);
+        return 0;
+    }
+    PyArrayObject* data = rational_array(data_,1,1);
+    PyArrayObject* rows = data?index_array(rows_):0;
+    PyArrayObject* cols = rows?index_array(cols_):0;
+    PyObject* result = 0;
+    if (cols) {
+        const npy_intp count = PyArray_DIM(data,0);
+        const int64_t *i = (const int64_t*)PyArray_DATA(rows), *j = (const int64_t*)PyArray_DATA(cols);
+        bool valid = PyArray_DIM(rows,0)==count && PyArray_DIM(cols,0)==count;
+        if (!valid)
+            PyErr_Format(PyExc_ValueError,"rational_csr: data, rows, and cols have different lengths %ld, %ld, %ld",
+                long(count),long(PyArray_DIM(rows,0)),long(PyArray_DIM(cols,0)));
+        for (npy_intp e = 0; e < count && valid; e++)
+            if (!(0<=i[e] && i[e]<m && 0<=j[e] && j[e]<n)) {
+                PyErr_Format(PyExc_IndexError,"rational_csr: index (%ld,%ld) out of range for shape (%ld,%ld)",long(i[e]),long(j[e]),m,n);
+                valid = false;
+            }
+        if (valid) {
+            try {
+                result = PyRationalCSR_FromMatrix(sparse_matrix::from_coordinates(m,n,count,i,j,(const rational*)PyArray_DATA(data)));
+            } catch (const exception& e) {
+                set_python_error(e);
+            }
+        }
+    }
+    Py_XDECREF(data);
+    Py_XDECREF(rows);
+    Py_XDECREF(cols);
+    return result;
+}
+
+void csr_dealloc(PyObject* self) {
+    delete ((PyRationalCSR*)self)->A;
+    Py_TYPE(self)->tp_free(self);
+}
+
+PyObject* csr_repr(PyObject* self) {
+    const sparse_matrix& A = csr(self);
+    return PyString_FromFormat("rational_csr(shape=(%ld,%ld),nnz=%ld)",long(A.m),long(A.n),long(A.nnz()));
+}
+
+// A.dot(x) for sparse A and dense vector, dense matrix, or sparse matrix x
+PyObject* csr_dot(PyObject* self, PyObject* other) {
+    const sparse_matrix& A = csr(self);
+    if (PyRationalCSR_Check(other)) {
+        const sparse_matrix& B = csr(other);
+        if (A.n!=B.m) {
+            PyErr_Format(PyExc_ValueError,"rational_csr.dot: shapes (%ld,%ld) and (%ld,%ld) don't match",long(A.m),long(A.n),long(B.m),long(B.n));
+            return 0;
+        }
+        try {
+            return PyRationalCSR_FromMatrix(A*B);
+        } catch (const exception& e) {
+            set_python_error(e);
+            return 0;
+        }
+    }
+    PyArrayObject* x = rational_array(other,1,2);
+    if (!x)
+        return 0;
+    const int ndim = PyArray_NDIM(x);
+    npy_intp dims[2] = {A.m,ndim==2?PyArray_DIM(x,1):1};
+    PyArrayObject* y = 0;
+    if (PyArray_DIM(x,0)!=A.n)
+        PyErr_Format(PyExc_ValueError,"rational_csr.dot: shape (%ld,%ld) doesn't match %ld rows",long(A.m),long(A.n),long(PyArray_DIM(x,0)));
+    else if ((y = new_rational_array(ndim,dims))) {
+        bool failed = false;
+        Py_BEGIN_ALLOW_THREADS
+        try {
+            if (ndim==1)
+                A.multiply((const rational*)PyArray_DATA(x),(rational*)PyArray_DATA(y));
+            else
+                A.multiply(dims[1],(const rational*)PyArray_DATA(x),(rational*)PyArray_DATA(y));
+        } catch (const exception& e) {
+            set_python_error(e);
+            failed = true;
+        }
+        Py_END_ALLOW_THREADS
+        if (failed)
+            Py_CLEAR(y);
+    }
+    Py_DECREF(x);
+    return (PyObject*)y;
+}
+
+PyObject* csr_transpose(PyObject* self, PyObject* args) {
+    try {
+        return PyRationalCSR_FromMatrix(csr(self).transpose());
+    } catch (const exception& e) {
+        set_python_error(e);
+        return 0;
+    }
+}
+
+PyObject* csr_todense(PyObject* self, PyObject* args) {
+    const sparse_matrix& A = csr(self);
+    npy_intp dims[2] = {A.m,A.n};
+    PyArrayObject* dense = new_rational_array(2,dims);
+    if (dense)
+        A.to_dense((rational*)PyArray_DATA(dense));
+    return (PyObject*)dense;
+}
+
+PyObject* csr_shape(PyObject* self, void* closure) {
+    return Py_BuildValue("ll",long(csr(self).m),long(csr(self).n));
+}
+
+PyObject* csr_nnz(PyObject* self, void* closure) {
+    return PyInt_FromLong(csr(self).nnz());
+}
+
+PyObject* csr_T(PyObject* self, void* closure) {
+    return csr_transpose(self,0);
+}
+
+// Copies of the CSR arrays, named as in scipy.sparse
+PyObject* csr_data(PyObject* self, void* closure) {
+    const sparse_matrix& A = csr(self);
+    npy_intp size = A.nnz();
+    PyArrayObject* data = new_rational_array(1,&size);
+    if (data)
+        std::copy(A.values.begin(),A.values.end(),(rational*)PyArray_DATA(data));
+    return (PyObject*)data;
+}
+
+PyObject* csr_index_copy(const std::vector<int64_t>& x) {
+    npy_intp size = x.size();
+    PyObject* array = PyArray_SimpleNew(1,&size,NPY_INT64);
+    if (array)
+        std::copy(x.begin(),x.end(),(int64_t*)PyArray_DATA((PyArrayObject*)array));
+    return array;
+}
+
+PyObject* csr_indices(PyObject* self, void* closure) {
+    return csr_index_copy(csr(self).columns);
+}
+
+PyObject* csr_indptr(PyObject* self, void* closure) {
+    return csr_index_copy(csr(self).offsets);
+}
+
+PyMethodDef csr_methods[] = {
+    {"dot",csr_dot,METH_O,"product with a dense vector, dense matrix, or rational_csr"},
+    {"transpose",csr_transpose,METH_NOARGS,"transposed copy"},
+    {"todense",csr_todense,METH_NOARGS,"dense rational array"},
+    {0} // sentinel
+};
+
+PyGetSetDef csr_getset[] = {
+    {(char*)"shape",csr_shape,0,(char*)"(rows,columns)",0},
+    {(char*)"nnz",csr_nnz,0,(char*)"number of nonzeros",0},
+    {(char*)"T",csr_T,0,(char*)"transpose",0},
+    {(char*)"data",csr_data,0,(char*)"nonzero values in row major order",0},
+    {(char*)"indices",csr_indices,0,(char*)"column of each nonzero",0},
+    {(char*)"indptr",csr_indptr,0,(char*)"row i has nonzeros indptr[i]:indptr[i+1]",0},
+    {0} // sentinel
+};
+
+PyTypeObject PyRationalCSR_Type = {
+    PyObject_HEAD_INIT(&PyType_Type)
+    0,                                        // ob_size
+    "rational_csr",                           // tp_name
+    sizeof(PyRationalCSR),                    // tp_basicsize
+    0,                                        // tp_itemsize
+    csr_dealloc,                              // tp_dealloc
+    0,                                        // tp_print
+    0,                                        // tp_getattr
+    0,                                        // tp_setattr
+    0,                                        // tp_compare
+    csr_repr,                                 // tp_repr
+    0,                                        // tp_as_number
+    0,                                        // tp_as_sequence
+    0,                                        // tp_as_mapping
+    0,                                        // tp_hash
+    0,                                        // tp_call
+    0,                                        // tp_str
+    0,                                        // tp_getattro
+    0,                                        // tp_setattro
+    0,                                        // tp_as_buffer
+    Py_TPFLAGS_DEFAULT,                       // tp_flags
+    "Compressed sparse row matrix of rationals", // tp_doc
+    0,                                        // tp_traverse
+    0,                                        // tp_clear
+    0,                                        // tp_richcompare
+    0,                                        // tp_weaklistoffset
+    0,                                        // tp_iter
+    0,                                        // tp_iternext
+    csr_methods,                              // tp_methods
+    0,                                        // tp_members
+    csr_getset,                               // tp_getset
+    0,                                        // tp_base
+    0,                                        // tp_dict
+    0,                                        // tp_descr_get
+    0,                                        // tp_descr_set
+    0,                                        // tp_dictoffset
+    0,                                        // tp_init
+    0,                                        // tp_alloc
+    csr_new,                                  // tp_new
+    0,                                        // tp_free
+};
+
 PyMethodDef module_methods[] = {
+    {"simplex",simplex,METH_VARARGS,"simplex(c,A,b,bland=0) minimizes c.x s.t. Ax = b, x >= 0 exactly, returning (status,value,x) with status one of 'optimal', 'unbounded', or 'infeasible'"},
+    {"simplex_batch",simplex_batch,METH_VARARGS,"simplex_batch(c,A,b,bland=0) solves the LPs (c[k],A[k],b[k]) as simplex does, in parallel and warm starting each from the last, returning a list of (status,value,x,pivots) with status 'overflow' if a problem doesn't fit in rationals"},
+    {"benchmark_gcd",benchmark_gcd,METH_VARARGS,"benchmark_gcd(count) times Euclid's and binary gcd on count random 128-bit pairs, returning (euclid,binary) in seconds"},
     {0} // sentinel
 };
 
@@ -865,13 +2306,16 @@ initrational() {
     // Initialize rational type object
     if (PyType_Ready(&PyRational_Type) < 0)
         return;
+    PyRational32_Type.tp_base = &PyRational_Type;
+    if (PyType_Ready(&PyRational32_Type) < 0)
+        return;
 
     // Initialize rational descriptor
     PyArray_InitArrFuncs(&rational_arrfuncs);
     rational_arrfuncs.getitem = rational_getitem;
     rational_arrfuncs.setitem = rational_setitem;
-    rational_arrfuncs.copyswapn = rational_copyswapn;
-    rational_arrfuncs.copyswap = rational_copyswap;
+    rational_arrfuncs.copyswapn = rational_copyswapn<rational>;
+    rational_arrfuncs.copyswap = rational_copyswap<rational>;
     rational_arrfuncs.compare = rational_compare;
     rational_arrfuncs.argmin = rational_argmin;
     rational_arrfuncs.argmax = rational_argmax;
@@ -902,7 +2346,42 @@ initrational() {
     if (register_cast<bool,rational>(PyArray_DescrFromType(NPY_BOOL),npy_rational,true)<0) return;
     if (register_cast<rational,bool>(&rational_descr,NPY_BOOL,false)<0) return;
 
-    // Register ufuncs
+    // Initialize rational32 descriptor
+    PyArray_InitArrFuncs(&rational32_arrfuncs);
+    rational32_arrfuncs.getitem = rational32_getitem;
+    rational32_arrfuncs.setitem = rational32_setitem;
+    rational32_arrfuncs.copyswapn = rational_copyswapn<rational32>;
+    rational32_arrfuncs.copyswap = rational_copyswap<rational32>;
+    rational32_arrfuncs.compare = rational32_compare;
+    rational32_arrfuncs.argmin = rational32_argmin;
+    rational32_arrfuncs.argmax = rational32_argmax;
+    rational32_arrfuncs.dotfunc = rational32_dot;
+    rational32_arrfuncs.nonzero = rational32_nonzero;
+    rational32_arrfuncs.fill = rational32_fill;
+    rational32_arrfuncs.fillwithscalar = rational32_fillwithscalar;
+    rational32_descr.ob_type = &PyArrayDescr_Type;
+    int npy_rational32 = PyArray_RegisterDataType(&rational32_descr);
+    if (npy_rational32<0) return;
+    if (PyDict_SetItemString(PyRational32_Type.tp_dict,"dtype",(PyObject*)&rational32_descr)<0) return;
+
+    // Register casts to and from rational32.  Only widening to rational and from small integers is safe.
+    if (register_cast<rational32,rational>(&rational32_descr,npy_rational,true)<0) return;
+    if (register_cast<rational,rational32>(&rational_descr,npy_rational32,false)<0) return;
+    #define REGISTER_INT_CONVERSIONS_32(bits,safe) \
+        if (register_cast<int##bits##_t,rational32>(PyArray_DescrFromType(NPY_INT##bits),npy_rational32,safe)<0) return; \
+        if (register_cast<uint##bits##_t,rational32>(PyArray_DescrFromType(NPY_UINT##bits),npy_rational32,bits<32 && safe)<0) return; \
+        if (register_cast<rational32,int##bits##_t>(&rational32_descr,NPY_INT##bits,false)<0) return; \
+        if (register_cast<rational32,uint##bits##_t>(&rational32_descr,NPY_UINT##bits,false)<0) return;
+    REGISTER_INT_CONVERSIONS_32(8,true)
+    REGISTER_INT_CONVERSIONS_32(16,true)
+    REGISTER_INT_CONVERSIONS_32(32,true)
+    REGISTER_INT_CONVERSIONS_32(64,false)
+    if (register_cast<rational32,float >(&rational32_descr,NPY_FLOAT,false)<0) return;
+    if (register_cast<rational32,double>(&rational32_descr,NPY_DOUBLE,true)<0) return;
+    if (register_cast<bool,rational32>(PyArray_DescrFromType(NPY_BOOL),npy_rational32,true)<0) return;
+    if (register_cast<rational32,bool>(&rational32_descr,NPY_BOOL,false)<0) return;
+
+    // Register ufuncs.  rational32 gets the same loops, with its inputs cast to rational.
     #define REGISTER_UFUNC(name,...) ({ \
         PyUFuncObject* ufunc = (PyUFuncObject*)PyObject_GetAttrString(numpy,#name); \
         if (!ufunc) return; \
@@ -912,6 +2391,7 @@ initrational() {
             return; \
         } \
         if (PyUFunc_RegisterLoopForType((PyUFuncObject*)ufunc,npy_rational,rational_ufunc_##name,_types,0)<0) return; \
+        if (PyUFunc_RegisterLoopForType((PyUFuncObject*)ufunc,npy_rational32,rational_ufunc_##name,_types,0)<0) return; \
         });
     #define REGISTER_UFUNC_BINARY_RATIONAL(name) REGISTER_UFUNC(name,{npy_rational,npy_rational,npy_rational})
     #define REGISTER_UFUNC_BINARY_COMPARE(name) REGISTER_UFUNC(name,{npy_rational,npy_rational,NPY_BOOL})
@@ -952,6 +2432,14 @@ initrational() {
     // Add rational type
     Py_INCREF(&PyRational_Type);
     PyModule_AddObject(m,"rational",(PyObject*)&PyRational_Type);
+    Py_INCREF(&PyRational32_Type);
+    PyModule_AddObject(m,"rational32",(PyObject*)&PyRational32_Type);
+
+    // Add sparse matrix type
+    if (PyType_Ready(&PyRationalCSR_Type) < 0)
+        return;
+    Py_INCREF(&PyRationalCSR_Type);
+    PyModule_AddObject(m,"rational_csr",(PyObject*)&PyRationalCSR_Type);
 
     // Create numerator and denominator ufuncs
     #define NEW_UNARY_UFUNC(name,type,doc) ({ \
@@ -959,6 +2447,7 @@ initrational() {
         if (!ufunc) return; \
         int types[2] = {npy_rational,type}; \
         if (PyUFunc_RegisterLoopForType((PyUFuncObject*)ufunc,npy_rational,rational_ufunc_##name,types,0)<0) return; \
+        if (PyUFunc_RegisterLoopForType((PyUFuncObject*)ufunc,npy_rational32,rational_ufunc_##name,types,0)<0) return; \
         PyModule_AddObject(m,#name,(PyObject*)ufunc); \
         })
     NEW_UNARY_UFUNC(numerator,NPY_INT64,"rational number numerator");
@@ -975,4 +2464,19 @@ initrational() {
         })
     GCD_LCM_UFUNC(gcd,NPY_INT64,"greatest common denominator of two integers");
     GCD_LCM_UFUNC(lcm,NPY_INT64,"least common multiple of two integers");
+
+    // Create gufuncs
+    #define NEW_GUFUNC(name,signature,doc,...) ({ \
+        int types[] = __VA_ARGS__; \
+        const int nargs = sizeof(types)/sizeof(int); \
+        PyObject* ufunc = PyUFunc_FromFuncAndDataAndSignature(0,0,0,0,nargs-1,1,PyUFunc_None,(char*)#name,(char*)doc,0,signature); \
+        if (!ufunc) return; \
+        if (PyUFunc_RegisterLoopForType((PyUFuncObject*)ufunc,npy_rational,rational_ufunc_##name,types,0)<0) return; \
+        if (PyUFunc_RegisterLoopForType((PyUFuncObject*)ufunc,npy_rational32,rational_ufunc_##name,types,0)<0) return; \
+        PyModule_AddObject(m,#name,(PyObject*)ufunc); \
+        })
+    NEW_GUFUNC(matmul,"(m,n),(n,p)->(m,p)","matrix multiplication of rational arrays, broadcasting over leading dimensions",
+        {npy_rational,npy_rational,npy_rational});
+    NEW_GUFUNC(argmin_ratio,"(n),(n)->()","first index minimizing a[i]/b[i] over b[i] > 0, or -1 if there is none",
+        {npy_rational,npy_rational,NPY_INTP});
 }
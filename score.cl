@@ -3,21 +3,41 @@
 #include "score.h"
 
 // Score a bunch of hands
-__kernel void score_hands_kernel(__global const cards_t* cards, __global score_t* results) {
-    const int id = get_global_id(0);
-    vstore4(score_hand(vload4(0,cards+4*id)),0,results+4*id);
-}
+#define DEFINE_SCORE_KERNEL(name,score) \
+    __kernel void name(__global const cards_t* cards, __global score_t* results) { \
+        const int id = get_global_id(0); \
+        vstorev(score(vloadv(0,cards+VECTOR_WIDTH*id)),0,results+VECTOR_WIDTH*id); \
+    }
+DEFINE_SCORE_KERNEL(score_hands_kernel,score_hand)
+DEFINE_SCORE_KERNEL(score_ace_five_kernel,score_ace_five)
+DEFINE_SCORE_KERNEL(score_deuce_seven_kernel,score_deuce_seven)
+#undef DEFINE_SCORE_KERNEL
 
-// Given Alice's and Bob's hands, determine outcomes for one block of shared cards
-__kernel void compare_cards_kernel(__global const five_subset_t* five_subsets, __global const cards_t* free, __global uint64_t* results, const cards_t alice_cards, const cards_t bob_cards) {
-    const int id = get_global_id(0);
-    const int offset = id*BLOCK_SIZE;
-    //const int bound = min(BLOCK_SIZE,NUM_FIVE_SUBSETS-offset);
-    uint64_tv sum = 0;
-    for (int i = 0; i < BLOCK_SIZE/4; i++)
-        sum += compare_cards(alice_cards,bob_cards,free,vload4(0,five_subsets+offset+4*i));
-    results[id] = sum.s0+sum.s1+sum.s2+sum.s3;
-}
+// Determine outcomes for one block of shared cards for each of a batch of matchups.
+// The first global dimension indexes blocks and the second indexes matchups.  The last block is ragged, and the
+// first dimension may be padded up to a multiple of the work-group size, in which case the extra work items
+// contribute zero.  five_subsets must be padded so that vector loads past the end stay in bounds.
+#define DEFINE_COMPARE_KERNEL(name,compare,boards) \
+    __kernel void name(__global const five_subset_t* five_subsets, __global const matchup_t* matchups, __global uint64_t* results) { \
+        const int id = get_global_id(0), job = get_global_id(1); \
+        const int offset = id*BLOCK_SIZE; \
+        const int bound = min(BLOCK_SIZE,(boards)-offset); \
+        __global const matchup_t* m = matchups+job; \
+        const cards_t alice_cards = m->alice_cards, bob_cards = m->bob_cards; \
+        uint64_tv sum = 0; \
+        if (bound==BLOCK_SIZE) \
+            for (int i = 0; i < BLOCK_SIZE/VECTOR_WIDTH; i++) \
+                sum += compare(alice_cards,bob_cards,m->free,vloadv(0,five_subsets+offset+VECTOR_WIDTH*i)); \
+        else /* Mask off lanes past the end */ \
+            for (int i = 0; i < bound; i += VECTOR_WIDTH) \
+                sum += if_gtl((uint64_tv)bound,i+VECTOR_IOTA,compare(alice_cards,bob_cards,m->free,vloadv(0,five_subsets+offset+i)),(uint64_tv)0); \
+        results[job*get_global_size(0)+id] = VECTOR_REDUCE(+,sum); \
+    }
+DEFINE_COMPARE_KERNEL(compare_matchups_kernel,compare_cards,NUM_FIVE_SUBSETS)
+DEFINE_COMPARE_KERNEL(compare_omaha_kernel,compare_omaha,NUM_OMAHA_BOARDS) // Omaha matchups use only 44 free cards
+DEFINE_COMPARE_KERNEL(compare_omaha8_kernel,compare_omaha8,NUM_OMAHA_BOARDS) // Results are packed SPLIT_BITS counters
+DEFINE_COMPARE_KERNEL(compare_short_kernel,compare_short_cards,NUM_SHORT_BOARDS) // Short deck matchups use only 32 free cards
+#undef DEFINE_COMPARE_KERNEL
 
 inline cards_tv mostly_random_set(uint64_tv r) {
     cards_tv cards = 0;
@@ -35,9 +55,11 @@ inline cards_tv mostly_random_set(uint64_tv r) {
 __kernel void hash_scores_kernel(__global uint64_t* results, const uint64_t offset) {
     const int id = get_global_id(0), i = offset+id;
     uint64_t h = 0;
-    for (int j = 0; j < 1024/4; j++) {
-        const score_tv score = score_hand(mostly_random_set(hash2v(i,(uint64_tv)(4*j,4*j+1,4*j+2,4*j+3))));
-        h = hash2(hash2(hash2(hash2(h,score.s0),score.s1),score.s2),score.s3);
+    for (int j = 0; j < 1024/VECTOR_WIDTH; j++) {
+        const score_tv score = score_hand(mostly_random_set(hash2v(i,VECTOR_WIDTH*j+VECTOR_IOTA)));
+        #define H(s) h = hash2(h,s)
+        VECTOR_MAP(H,score);
+        #undef H
     }
     results[id] = h;
 }
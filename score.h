@@ -3,11 +3,40 @@
 #ifndef __exact_h__
 #define __exact_h__
 
+// Kernel parameters.  These are tuned per device by passing -D options when building score.cl.
+#ifndef BLOCK_SIZE
+#define BLOCK_SIZE 256 // Number of five subsets summed by each work item
+#endif
+#ifndef VECTOR_WIDTH
+#define VECTOR_WIDTH 4 // Number of lanes in each vector type: 2, 4, or 8
+#endif
+
 #ifdef __OPENCL_VERSION__
+#define VECTOR_HELPER(type,n) type##n
+#define VECTOR(type) VECTOR_HELPER(type,VECTOR_WIDTH)
 typedef uint uint32_t;
-typedef uint4 uint32_tv;
+typedef VECTOR(uint) uint32_tv;
 typedef ulong uint64_t;
-typedef ulong4 uint64_tv;
+typedef VECTOR(ulong) uint64_tv;
+#define vloadv VECTOR(vload)
+#define vstorev VECTOR(vstore)
+
+// Apply a macro to each lane of a vector, or combine the lanes with an operator
+#if VECTOR_WIDTH==2
+#define VECTOR_MAP(f,x) (f((x).s0),f((x).s1))
+#define VECTOR_REDUCE(op,x) ((x).s0 op (x).s1)
+#define VECTOR_IOTA ((uint64_tv)(0,1))
+#elif VECTOR_WIDTH==4
+#define VECTOR_MAP(f,x) (f((x).s0),f((x).s1),f((x).s2),f((x).s3))
+#define VECTOR_REDUCE(op,x) ((x).s0 op (x).s1 op (x).s2 op (x).s3)
+#define VECTOR_IOTA ((uint64_tv)(0,1,2,3))
+#elif VECTOR_WIDTH==8
+#define VECTOR_MAP(f,x) (f((x).s0),f((x).s1),f((x).s2),f((x).s3),f((x).s4),f((x).s5),f((x).s6),f((x).s7))
+#define VECTOR_REDUCE(op,x) ((x).s0 op (x).s1 op (x).s2 op (x).s3 op (x).s4 op (x).s5 op (x).s6 op (x).s7)
+#define VECTOR_IOTA ((uint64_tv)(0,1,2,3,4,5,6,7))
+#else
+#error "VECTOR_WIDTH must be 2, 4, or 8"
+#endif
 #else
 #include <stdint.h>
 #include <algorithm>
@@ -33,6 +62,26 @@ typedef uint32_t five_subset_t;
 typedef uint32_tv five_subset_tv;
 #define NUM_FIVE_SUBSETS 1712304
 
+// Omaha boards are drawn from the 44 cards left after both players' four hole cards.  Since five_subsets is generated
+// in order of increasing maximum element, its first C(44,5) entries are exactly the five subsets of 44 elements.
+#define NUM_OMAHA_BOARDS 1086008
+
+// Omaha-8 comparisons count how many quarters of the pot Alice gets (0 to 4) on each board, packed into SPLIT_BITS
+// bit counters.  Each work item sums at most BLOCK_SIZE boards, so the counters can't overflow.
+#define SPLIT_BITS 12
+#if BLOCK_SIZE>=(1<<SPLIT_BITS)
+#error "BLOCK_SIZE is too large for packed Omaha-8 counters"
+#endif
+
+// Short deck (6+) hold'em removes the 2s through 5s, leaving 32 cards for the board after both players' hands
+#define NUM_SHORT_BOARDS 201376
+
+// One comparison job: Alice's and Bob's hands, and the 48 cards left for the board
+typedef struct {
+    cards_t alice_cards, bob_cards;
+    cards_t free[48];
+} matchup_t;
+
 // Hand types
 #define HIGH_CARD      (1<<27)
 #define PAIR           (2<<27)
@@ -44,9 +93,15 @@ typedef uint32_tv five_subset_tv;
 #define QUADS          (8<<27)
 #define STRAIGHT_FLUSH (9<<27)
 
+// Short deck ranks flushes above full houses, so those two types trade places
+#define SHORT_FULL_HOUSE FLUSH
+#define SHORT_FLUSH      FULL_HOUSE
+
 #define TYPE_MASK (0xffff<<27)
 
-#define BLOCK_SIZE 256
+// Lowball scores are inverted high hand scores of the chosen five cards, so that larger is still better.
+// Inverting a low score recovers the high style score, e.g., for extracting its type.
+#define INVERT_SCORE(s) ((10<<27)-1-(s))
 
 // Extract the minimum bit, assuming a nonzero input (2 operations)
 #define min_bit(x) ((x)&-(x))
@@ -64,10 +119,21 @@ inline score_tv drop_bit(score_tv x);
 inline score_tv drop_two_bits(score_tv x);
 inline cards_tv count_suits(cards_tv cards);
 inline score_tv cards_with_suit(cards_tv cards, cards_tv suits);
-inline score_tv all_straights(score_tv unique);
+inline score_tv all_straights(score_tv unique, const score_t low_ace);
 inline score_tv max_bit(score_tv x);
-score_tv score_hand(cards_tv cards);
+inline score_tv score_cards(cards_tv cards, const int n, const bool short_deck, const bool wheel);
+inline score_tv score_hand(cards_tv cards);
+inline score_tv score_five(cards_tv cards);
+inline score_tv score_short_hand(cards_tv cards);
+inline score_tv score_ace_five(cards_tv cards);
+inline score_tv score_deuce_seven(cards_tv cards);
+inline score_tv score_omaha(cards_t hole, cards_tv board);
+inline score_tv score_omaha_low(cards_t hole, cards_tv board);
+inline uint64_tv compare_scores(score_tv alice_score, score_tv bob_score);
 inline uint64_tv compare_cards(cards_t alice_cards, cards_t bob_cards, __global const cards_t* free, five_subset_tv set);
+inline uint64_tv compare_omaha(cards_t alice_cards, cards_t bob_cards, __global const cards_t* free, five_subset_tv set);
+inline uint64_tv compare_omaha8(cards_t alice_cards, cards_t bob_cards, __global const cards_t* free, five_subset_tv set);
+inline uint64_tv compare_short_cards(cards_t alice_cards, cards_t bob_cards, __global const cards_t* free, five_subset_tv set);
 inline cards_tv mostly_random_set(uint64_tv r);
 inline cards_t free_set(__global const cards_t* free, five_subset_t set);
 inline cards_tv free_sets(__global const cards_t* free, five_subset_tv set);
@@ -145,8 +211,8 @@ inline cards_tv count_suits(cards_tv cards) {
 }
 
 #ifdef __OPENCL_VERSION__
-#define convert_score convert_uint4
-#define convert_cards convert_ulong4
+#define convert_score VECTOR(convert_uint)
+#define convert_cards VECTOR(convert_ulong)
 #else
 #define convert_score(c) ((score_tv)(c))
 #define convert_cards(c) ((cards_tv)(c))
@@ -188,9 +254,10 @@ DEFINE_IFS(,uint32_tv)
 DEFINE_IFS(l,uint64_tv)
 #undef DEFINE_IFS
 
-// Find all straights in a (suited) set of cards, assuming cards == cards&0x1111111111111 (8 operations)
-inline score_tv all_straights(score_tv unique) {
-    const score_tv u = unique&(unique<<1|unique>>12); // the ace wraps around to the bottom
+// Find all straights in a (suited) set of cards, assuming cards == cards&0x1111111111111 (8 operations).
+// The ace wraps around to the bit low_ace: 1 below the 2, 1<<4 below the 6 for short deck, or 0 if aces are only high.
+inline score_tv all_straights(score_tv unique, const score_t low_ace) {
+    const score_tv u = unique&(unique<<1|(unique>>12)*low_ace);
     return u&u>>2&unique>>3;
 }
 
@@ -203,8 +270,11 @@ inline score_tv max_bit(score_tv x) {
     return ((score_t)1<<31)>>clz(x);
 }
 
-// Determine the best possible five card hand out of a bit set of seven cards (40+19+26+23+16+13+26+4 = 167 operations)
-score_tv score_hand(cards_tv cards) {
+// Determine the best possible five card hand out of a bit set of n = 5 or 7 cards (40+19+26+23+16+13+26+4 = 167 operations).
+// The only difference is how many kickers we drop.  short_deck switches to short deck straights and hand types, and
+// wheel says whether A-2-3-4-5 is a straight.  These should be compile time constants, so that each caller gets a
+// specialized evaluator.
+inline score_tv score_cards(cards_tv cards, const int n, const bool short_deck, const bool wheel) {
     #define SCORE(type,c0,c1) ((type)|((c0)<<14)|(c1)) // 3 operations
     const score_t each_card = 0x1fff;
     const cards_t each_suit = 1+((cards_t)1<<13)+((cards_t)1<<26)+((cards_t)1<<39);
@@ -213,7 +283,8 @@ score_tv score_hand(cards_tv cards) {
     const cards_tv suits = count_suits(cards);
     const cards_tv flushes = each_suit&suits>>2&(suits>>1|suits); // Detect suits with at least 5 cards
     const score_tv suited = cards_with_suit(cards,flushes);
-    const score_tv straight_flushes = all_straights(suited);
+    const score_t low_ace = short_deck?1<<4:wheel?1:0;
+    const score_tv straight_flushes = all_straights(suited,low_ace);
     score_tv score = if_nz1(straight_flushes,SCORE(STRAIGHT_FLUSH,0,max_bit(straight_flushes)));
 
     // Check for four of a kind (2+3+2+3+1+2+3+2+1 = 19 operations)
@@ -228,21 +299,22 @@ score_tv score_hand(cards_tv cards) {
     const score_tv trips = if_nz1(all_trips,max_bit(all_trips));
     const score_tv pairs_and_trips = each_card&(cand|cand>>13|(cor&cor>>13));
     const score_tv pairs = pairs_and_trips-trips;
-    score = max(score,select((score_tv)0,SCORE(FULL_HOUSE,trips,max_bit(pairs)),(pairs!=0)&(trips!=0)));
+    score = max(score,select((score_tv)0,SCORE(short_deck?SHORT_FULL_HOUSE:FULL_HOUSE,trips,max_bit(pairs)),(pairs!=0)&(trips!=0)));
 
     // Check for flushes (7+2*(2+1+2)+1+2+3 = 23 operations)
     const score_tv suit_count = cards_with_suit(suits,flushes);
     score_tv best_suited = suited;
     best_suited = if_gt(suit_count,5u,best_suited-min_bit(best_suited),best_suited);
     best_suited = if_gt(suit_count,6u,best_suited-min_bit(best_suited),best_suited);
-    score = max(score,if_nz1(best_suited,SCORE(FLUSH,0,best_suited)));
+    score = max(score,if_nz1(best_suited,SCORE(short_deck?SHORT_FLUSH:FLUSH,0,best_suited)));
 
     // Check for straights (8+1+2+3+2 = 16 operations)
-    const score_tv straights = all_straights(unique);
+    const score_tv straights = all_straights(unique,low_ace);
     score = max(score,if_nz1(straights,SCORE(STRAIGHT,0,max_bit(straights))));
 
     // Check for three of a kind (7+1+2+3 = 13 operations)
-    const score_tv kickers = drop_two_bits(unique-pairs_and_trips);
+    const score_tv rest = unique-pairs_and_trips;
+    const score_tv kickers = n==7?drop_two_bits(rest):rest;
     score = max(score,if_nz1(trips,SCORE(TRIPS,trips,kickers)));
 
     // Check for pair or two pair (3+1+2+2+2+3+2+2+3+3+2+1 = 26 operations)
@@ -258,6 +330,121 @@ score_tv score_hand(cards_tv cards) {
     #undef SCORE
 }
 
+inline score_tv score_hand(cards_tv cards) {
+    return score_cards(cards,7,false,true);
+}
+
+inline score_tv score_five(cards_tv cards) {
+    return score_cards(cards,5,false,true);
+}
+
+inline score_tv score_short_hand(cards_tv cards) {
+    return score_cards(cards,7,true,true);
+}
+
+// Determine the best 2-7 low hand out of exactly five cards.  Aces are high, and straights and flushes count, so the
+// best low is the worst high hand, except that A-2-3-4-5 is not a straight.
+inline score_tv score_deuce_seven(cards_tv cards) {
+    return INVERT_SCORE(score_cards(cards,5,false,false));
+}
+
+// Determine the best A-5 low hand out of five to seven cards.  Aces are low and straights and flushes don't count,
+// so we want as many distinct ranks as possible, and then the lowest ones.  With fewer than five distinct ranks, the
+// lowest duplicated ranks fill out the hand, and a full house beats quads.
+inline score_tv score_ace_five(cards_tv cards) {
+    #define SCORE(type,c0,c1) ((type)|((c0)<<14)|(c1))
+    // Split into suits, rotating the ace down below the 2
+    score_tv s[4];
+    for (int i = 0; i < 4; i++) {
+        const score_tv r = convert_score(cards>>13*i)&0x1fff;
+        s[i] = (r<<1|r>>12)&0x1fff;
+    }
+    // Find ranks with at least one, two, three, and four cards
+    const score_tv unique = s[0]|s[1]|s[2]|s[3],
+                   two = (s[0]&s[1])|(s[0]&s[2])|(s[0]&s[3])|(s[1]&s[2])|(s[1]&s[3])|(s[2]&s[3]),
+                   three = (s[0]&s[1]&(s[2]|s[3]))|(s[2]&s[3]&(s[0]|s[1])),
+                   four = s[0]&s[1]&s[2]&s[3];
+    // Take the five lowest distinct ranks.  low_bits[i] is nonzero iff there are more than i distinct ranks.
+    score_tv rest = unique, low = 0, low_bits[5];
+    for (int i = 0; i < 5; i++) {
+        low_bits[i] = min_bit(rest);
+        low |= low_bits[i];
+        rest -= low_bits[i];
+    }
+    // Score each possible number of distinct ranks, from two up to five
+    const score_tv pair = min_bit(two),
+                   pairs = pair|min_bit(two-pair),
+                   trips = min_bit(three);
+    score_tv score = if_nz(two-trips,SCORE(FULL_HOUSE,trips,min_bit(two-trips)),SCORE(QUADS,four,unique-four));
+    score = if_nz(low_bits[2],if_nz(two-pair,SCORE(TWO_PAIR,pairs,unique-pairs),SCORE(TRIPS,trips,unique-trips)),score);
+    score = if_nz(low_bits[3],SCORE(PAIR,pair,unique-pair),score);
+    score = if_nz(low_bits[4],SCORE(HIGH_CARD,0,low),score);
+    return INVERT_SCORE(score);
+    #undef SCORE
+}
+
+// Determine the best Omaha hand, which must use exactly two of four hole cards and three of five board cards.
+// Each lane has a different board, so we split the boards into single cards with vector operations, and take a
+// vector max over all 6*10 = 60 combinations.
+inline score_tv score_omaha(cards_t hole, cards_tv board) {
+    cards_t h[4];
+    for (int i = 0; i < 4; i++) {
+        h[i] = min_bit(hole);
+        hole -= h[i];
+    }
+    cards_tv b[5];
+    for (int i = 0; i < 5; i++) {
+        b[i] = min_bit(board);
+        board -= b[i];
+    }
+    cards_tv triples[10];
+    int n = 0;
+    for (int i = 0; i < 5; i++)
+        for (int j = 0; j < i; j++)
+            for (int k = 0; k < j; k++)
+                triples[n++] = b[i]|b[j]|b[k];
+    score_tv score = 0;
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < i; j++)
+            for (int k = 0; k < 10; k++)
+                score = max(score,score_five((h[i]|h[j])|triples[k]));
+    return score;
+}
+
+// Collapse single cards to their rank bits, with the ace rotated below the 2
+#define LOW_RANK(r) (((r)<<1|(r)>>12)&0x1fff)
+#define FOLD_SUITS(c) ((c)|(c)>>13|(c)>>26|(c)>>39)
+
+// Determine the best Omaha 8-or-better low, using exactly two hole cards and three board cards.  A low needs five
+// distinct ranks no higher than 8, with aces low.  Returns zero if there is no qualifying low, and otherwise a score
+// where larger is better.  Since each card contributes one rank bit, the ranks are distinct iff their sum equals
+// their union, and then smaller unions are better lows.
+inline score_tv score_omaha_low(cards_t hole, cards_tv board) {
+    score_t h[4];
+    for (int i = 0; i < 4; i++) {
+        const cards_t c = min_bit(hole);
+        hole -= c;
+        h[i] = LOW_RANK((score_t)FOLD_SUITS(c)&0x1fff);
+    }
+    score_tv b[5];
+    for (int i = 0; i < 5; i++) {
+        const cards_tv c = min_bit(board);
+        board -= c;
+        b[i] = LOW_RANK(convert_score(FOLD_SUITS(c))&0x1fff);
+    }
+    score_tv low = 0;
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < i; j++)
+            for (int k = 0; k < 5; k++)
+                for (int l = 0; l < k; l++)
+                    for (int m = 0; m < l; m++) {
+                        const score_tv sum = h[i]+h[j]+b[k]+b[l]+b[m],
+                                       all = h[i]|h[j]|b[k]|b[l]|b[m];
+                        low = max(low,if_eq(sum,all,if_gt((score_tv)0x100,all,0x100-all,(score_tv)0),(score_tv)0));
+                    }
+    return low;
+}
+
 inline cards_t free_set(__global const cards_t* free, five_subset_t set) {
     #define F(i) free[set>>(6*i)&0x3f]
     return F(0)|F(1)|F(2)|F(3)|F(4);
@@ -266,19 +453,53 @@ inline cards_t free_set(__global const cards_t* free, five_subset_t set) {
 
 inline cards_tv free_sets(__global const cards_t* free, five_subset_tv set) {
 #ifdef __OPENCL_VERSION__
-    return (cards_tv)(free_set(free,set.s0),free_set(free,set.s1),free_set(free,set.s2),free_set(free,set.s3));
+    #define F(s) free_set(free,s)
+    return (cards_tv)VECTOR_MAP(F,set);
+    #undef F
 #else
     return free_set(free,set);
 #endif
 }
 
+// Pack the outcome of a comparison: Alice's wins go in the high 32 bits and Bob's in the low 32 bits
+inline uint64_tv compare_scores(score_tv alice_score, score_tv bob_score) {
+    const cards_tv a = convert_cards(alice_score),
+                   b = convert_cards(bob_score);
+    return if_gtl(a,b,(uint64_tv)1<<32,
+           if_gtl(b,a,(uint64_tv)1,(uint64_tv)0));
+}
+
 // Evaluate a full set of hands and shared cards
 inline uint64_tv compare_cards(cards_t alice_cards, cards_t bob_cards, __global const cards_t* free, five_subset_tv set) {
     const cards_tv shared_cards = free_sets(free,set);
-    const cards_tv alice_score = convert_cards(score_hand(shared_cards|alice_cards)),
-                   bob_score   = convert_cards(score_hand(shared_cards|bob_cards));
-    return if_gtl(alice_score,bob_score,(uint64_tv)1<<32,
-           if_gtl(bob_score,alice_score,(uint64_tv)1,(uint64_tv)0));
+    return compare_scores(score_hand(shared_cards|alice_cards),score_hand(shared_cards|bob_cards));
+}
+
+// Evaluate Omaha hands (four hole cards each) on a set of boards drawn from the first 44 free cards
+inline uint64_tv compare_omaha(cards_t alice_cards, cards_t bob_cards, __global const cards_t* free, five_subset_tv set) {
+    const cards_tv board = free_sets(free,set);
+    return compare_scores(score_omaha(alice_cards,board),score_omaha(bob_cards,board));
+}
+
+// Evaluate Omaha-8 hands on a set of boards drawn from the first 44 free cards.  The high half of the pot goes to the
+// best high hand, and the low half to the best qualifying low, or to the best high hand if neither player has a low.
+// Each lane counts one board in the SPLIT_BITS bit counter for the number of quarters of the pot Alice gets.
+inline uint64_tv compare_omaha8(cards_t alice_cards, cards_t bob_cards, __global const cards_t* free, five_subset_tv set) {
+    const cards_tv board = free_sets(free,set);
+    const cards_tv alice_high = convert_cards(score_omaha(alice_cards,board)),
+                   bob_high   = convert_cards(score_omaha(bob_cards,board)),
+                   alice_low  = convert_cards(score_omaha_low(alice_cards,board)),
+                   bob_low    = convert_cards(score_omaha_low(bob_cards,board));
+    const uint64_tv high = if_gtl(alice_high,bob_high,(uint64_tv)2,if_eql(alice_high,bob_high,(uint64_tv)1,(uint64_tv)0)),
+                    low  = if_gtl(alice_low,bob_low,(uint64_tv)2,if_eql(alice_low,bob_low,(uint64_tv)1,(uint64_tv)0));
+    const uint64_tv quarters = if_nzl(alice_low|bob_low,high+low,2*high);
+    return (uint64_tv)1<<SPLIT_BITS*quarters;
+}
+
+// Evaluate short deck hands on a set of boards drawn from the first 32 free cards
+inline uint64_tv compare_short_cards(cards_t alice_cards, cards_t bob_cards, __global const cards_t* free, five_subset_tv set) {
+    const cards_tv shared_cards = free_sets(free,set);
+    return compare_scores(score_short_hand(shared_cards|alice_cards),score_short_hand(shared_cards|bob_cards));
 }
 
 #endif
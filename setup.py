@@ -6,6 +6,8 @@ from numpy.distutils.system_info import get_info
 module = Extension('rational',
                    sources = ['rational.cpp'],
                    # extra_compile_args = ['-g'],
+                   extra_compile_args = ['-fopenmp'], # matmul runs rows in parallel
+                   extra_link_args = ['-fopenmp'],
                    include_dirs = get_info('numpy')['include_dirs'])
 
 setup(name = 'rational',
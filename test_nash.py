@@ -27,6 +27,86 @@ def test_nash():
         assert A==dot(payoff,bob).max() # Can Alice do any better?
         assert A==dot(payoff.T,alice).min() # Can Bob do any better?
 
+def test_overflow():
+    # Large payoffs overflow 64-bit rationals, so the solves fall back to arbitrary precision fractions
+    random.seed(647121)
+    payoff = rationals(random.randint(-1<<40,1<<40,size=(4,5)))
+    A,alice,bob = zero_sum_nash_equilibrium(payoff)
+    P = fractions(payoff)
+    assert fractions(A)==dot(P,fractions(bob)).max()
+    assert fractions(A)==dot(P.T,fractions(alice)).min()
+    # Whether or not the rational solve overflows, we get the arbitrary precision result
+    c = -rationals([2,3,4])
+    A = rationals([[3,2,1],[2,5,3]])*(1<<40)+1
+    b = rationals([10,15])
+    f,x = simplex_method(c,A,b)
+    g,y = simplex_method(*map(fractions,(c,A,b)))
+    assert fractions(f)==g
+    assert all(fractions(x)==y)
+
+def test_native_simplex():
+    # The native solver pivots exactly as the tableau does, so even degenerate problems give the same vertex
+    random.seed(647121)
+    for _ in xrange(10):
+        m,n = random.randint(1,6,size=2)
+        M = rationals(random.randint(1,10,size=(m,n)))
+        c = hstack([rationals(random.randint(-2,5,size=n)),zeros(m,rational)])
+        A = hstack([M,-eye(m,dtype=rational)])
+        b = rationals(random.randint(1,3,size=m))
+        try:
+            f,x = simplex_method_dtype(c,A,b)
+        except Unbounded:
+            assert simplex(c,A,b)[0]=='unbounded'
+            continue
+        assert simplex(c,A,b)[0]=='optimal'
+        g,y = simplex_method(c,A,b)
+        assert f==g and all(x==y)
+        assert all(dot(A,y)==b) and all(y>=0)
+        assert simplex(c,A,b,1)[1]==f # Bland's rule may find another vertex, but not another value
+    # Unbounded, infeasible, and redundant problems
+    assert simplex(-rationals([1,0]),rationals([[1,-1]]),rationals([1]))==('unbounded',None,None)
+    assert simplex(rationals([1]),rationals([[1]]),rationals([-1]))==('infeasible',None,None)
+    status,f,x = simplex(rationals([1,2]),rationals([[1,1],[2,2]]),rationals([1,2]))
+    assert status=='optimal' and f==1 and all(x==[1,0])
+
+def test_box_nash():
+    # A sweep of small fixed bet style games: c = P 1, M = P*((1+bet)*D-1) with D antisymmetric
+    random.seed(647121)
+    n = 6
+    P = rationals(random.randint(1,5,size=(n,n)))
+    D = rationals(random.randint(-4,5,size=(n,n)))/4
+    D = D-D.T
+    bets = arange(12)/rational(3)
+    c = tile(P.sum(axis=1),(len(bets),1))
+    M = array([P*((1+b)*D-1) for b in bets])
+    for k,(equity,x,y) in enumerate(box_nash_equilibria(c,M)):
+        assert all(0<=x) and all(x<=1) and all(0<=y) and all(y<=1)
+        assert equity==dot(x,c[k])+dot(x,dot(M[k],y))
+        # Neither player can do better, and best responses to a fixed strategy are pure
+        assert equity==dot(x,c[k])+minimum(0,dot(x,M[k])).sum()
+        assert equity==maximum(0,c[k]+dot(M[k],y)).sum()
+    # Batched solves agree with individual solves
+    A = zeros((len(bets),n,2*n),rational)
+    A[:,:,:n] = M
+    A[:,:,n:] = -eye(n,dtype=rational)
+    cost = hstack([ones((len(bets),n),rational),zeros((len(bets),n),rational)])
+    b = ones((len(bets),n),rational)
+    batch = simplex_batch(cost,A,b)
+    for k,(status,f,x,pivots) in enumerate(batch):
+        status1,f1,x1 = simplex(cost[k],A[k],b[k])
+        assert status==status1 and f==f1
+        if status=='optimal':
+            assert all(dot(A[k],x)==b[k]) and all(x>=0)
+    # Overflow is reported per problem, without stopping the rest of the batch
+    big = (1<<62)-1
+    A = rationals([[[big,1],[1,big-2]],[[1,0],[0,1]]])
+    results = simplex_batch(rationals([[1,1],[1,2]]),A,rationals([[1,1],[1,1]]))
+    assert results[0]==('overflow',None,None,None)
+    assert results[1][:2]==('optimal',3)
+
 if __name__=='__main__':
     test_simplex()
     test_nash()
+    test_overflow()
+    test_native_simplex()
+    test_box_nash()
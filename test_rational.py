@@ -19,6 +19,22 @@ def test_misc():
     assert repr(y)=='rational(7)'
     assert repr(z)=='rational(3,5)'
 
+def test_fraction():
+    from fractions import Fraction
+    x = R(Fraction(-6,10))
+    assert x==R(-3,5)
+    assert (x.numerator,x.denominator)==(x.n,x.d)==(-3,5)
+    assert Fraction(x.numerator,x.denominator)==Fraction(-3,5)
+    a = zeros(2,rational)
+    a[1] = Fraction(7,3)
+    assert a[1]==R(7,3)
+    assert all(array([Fraction(1,2),Fraction(2,3)],dtype=object).astype(rational)==[R(1,2),R(2,3)])
+    try:
+        R(Fraction(1,1<<70))
+        assert False
+    except OverflowError:
+        pass
+
 def test_parse():
     assert rational("4")==4
     assert rational(" -4 ")==-4
@@ -76,6 +92,40 @@ def test_arithmetic():
         assert abs(x)==R(abs(xn),abs(xd))
         # TODO: test floor, ceil, abs
 
+def test_add_paths():
+    # Cover each fast path of addition (equal denominators, integer operands, 64-bit products) and the 128-bit
+    # fallback, checking that overflow is raised exactly when the reduced result doesn't fit
+    from fractions import Fraction
+    random.seed(1262081)
+    big = (1<<63)-1
+    numerators = [0,1,-1,2,-3,7,720,1<<31,(1<<62)+1,-(1<<62)-1,big,-big]
+    denominators = [1,2,3,7,720,1<<31,(1<<62)+1,big]
+    def pick(values,lo,hi):
+        return int(random.choice(values)) if random.randint(2) else int(random.randint(lo,hi))
+    for _ in xrange(2000):
+        xn,yn = pick(numerators,-1000,1000),pick(numerators,-1000,1000)
+        xd,yd = pick(denominators,1,1000),pick(denominators,1,1000)
+        if random.randint(3)==0:
+            yd = xd
+        x,y = R(xn,xd),R(yn,yd)
+        for sub in 0,1:
+            exact = Fraction(xn,xd)-Fraction(yn,yd) if sub else Fraction(xn,xd)+Fraction(yn,yd)
+            fits = -big-1<=exact.numerator<=big and exact.denominator<=big
+            try:
+                z = x-y if sub else x+y
+                assert fits and (z.n,z.d)==(exact.numerator,exact.denominator)
+            except OverflowError:
+                assert not fits
+    # Intermediate overflow must not be reported when the reduced result fits
+    assert R(big)+R(-big)==0
+    assert R(-big)-R(-big)==0
+    assert R(big,2)+R(-big+2,2)==1
+    assert R(big,3)-R(big-3,3)==1
+    assert R(-big)+R(big,2)==R(-big,2)
+    # The binary and Euclidean gcds must agree (benchmark_gcd raises AssertionError otherwise)
+    euclid,binary = benchmark_gcd(1000)
+    assert euclid>=0 and binary>=0
+
 def test_errors():
     # Check invalid constructions
     for args in (R(3,2),4),(1.2,),(1,2,3):
@@ -243,6 +293,79 @@ def test_gcd_lcm():
     assert all(lcm(2,[1,2,3,4,5,6])==[2,2,6,4,10,6])
     assert lcm.reduce(arange(1,10))==2520
 
+def test_reduce():
+    # add.reduce and dot accumulate exactly, so partial sums may exceed 64 bits as long as the result fits
+    random.seed(1262081)
+    x = random.randint(-500,500,1000).astype(rational)/(1326*random.randint(1,4,1000))
+    s = R(0)
+    for v in x:
+        s += v
+    assert add.reduce(x)==s
+    assert sum(x)==s
+    assert dot(x,x)==sum(x*x)
+    big = (1<<63)-1
+    y = array([big,big,-big,-big,0]).astype(rational)
+    y[4] = R(1,3)
+    assert sum(y)==R(1,3)
+    assert dot(y,array([1,1,1,1,3]).astype(rational))==1
+    try:
+        sum(y[:2])
+        assert False
+    except OverflowError:
+        pass
+
+def test_matmul():
+    random.seed(1262081)
+    for m,n,p in (1,1,1),(3,4,5),(7,1,3),(40,150,70):
+        A = random.randint(-20,20,(m,n)).astype(rational)/random.randint(1,12,(m,n))
+        B = random.randint(-20,20,(n,p)).astype(rational)/random.randint(1,12,(n,p))
+        A[random.randint(2,size=(m,n))==0] = 0
+        C = matmul(A,B)
+        assert C.dtype==dtype(rational) and C.shape==(m,p)
+        assert all(C==dot(A,B))
+        # Strided inputs
+        assert all(matmul(B.T,A.T)==C.T)
+    # Broadcasting over leading dimensions
+    A = arange(24).astype(rational).reshape(2,3,4)/7
+    B = arange(20).astype(rational).reshape(4,5)/3
+    C = matmul(A,B)
+    assert C.shape==(2,3,5)
+    for i in xrange(2):
+        assert all(C[i]==dot(A[i],B))
+    # Overflow is detected
+    r = array([[1<<62,1<<62]]).astype(rational)
+    try:
+        matmul(r,r.T)
+        assert False
+    except OverflowError:
+        pass
+
+def test_argmin_ratio():
+    random.seed(1262081)
+    for n in 1,5,63,64,65,300:
+        for _ in xrange(20):
+            a = random.randint(-5,20,n).astype(rational)/random.randint(1,6,n)
+            b = random.randint(-4,6,n).astype(rational)/random.randint(1,6,n)
+            if random.randint(2): # Nearly tied ratios, which doubles can't separate
+                M = (1<<50)+random.randint(1000)
+                a = (3*M+random.randint(-1,2,n)).astype(rational)/M
+                b = ones(n,rational)
+                b[random.randint(4,size=n)==0] = -1
+            positive, = nonzero(b>0)
+            expected = positive[argmin(a[positive]/b[positive])] if len(positive) else -1
+            assert argmin_ratio(a,b)==expected
+    # Broadcasting and strides
+    a = arange(12).astype(rational).reshape(3,4)+1
+    b = array([[1,2,3,4],[-1,-1,-1,-1],[4,3,2,1]]).astype(rational)
+    assert all(argmin_ratio(a,b)==[0,-1,0])
+    assert all(argmin_ratio(a.T,b.T)==0)
+    # Zeros in b are routine in simplex tableaus, and mustn't raise floating point errors
+    with errstate(all='raise'):
+        a = array([0,1,0,2,3]).astype(rational)
+        b = array([0,0,-1,1,2]).astype(rational)
+        assert argmin_ratio(a,b)==4
+        assert argmin_ratio(a,zeros(5,rational))==-1
+
 def test_numpy_errors():
     # Check that exceptions inside ufuncs are detected
     r = array([1<<62]).astype(rational)
@@ -258,6 +381,67 @@ def test_numpy_errors():
     except ZeroDivisionError:
         pass
 
+def test_sparse():
+    random.seed(1262081)
+    for m,n,p in (1,1,1),(3,4,5),(7,1,3),(0,2,2),(40,150,70):
+        A = random.randint(-20,20,(m,n)).astype(rational)/random.randint(1,12,(m,n))
+        A[random.randint(3,size=(m,n))!=0] = 0
+        B = random.randint(-20,20,(n,p)).astype(rational)/random.randint(1,12,(n,p))
+        B[random.randint(2,size=(n,p))==0] = 0
+        x = random.randint(-20,20,n).astype(rational)/7
+        S = rational_csr(A)
+        assert S.shape==(m,n) and S.nnz==sum(A!=0)
+        assert all(S.todense()==A)
+        assert all(S.indptr==hstack([0,cumsum(sum(A!=0,axis=1))]))
+        assert all(S.data==A[A!=0])
+        assert all(S.dot(x)==dot(A,x))
+        assert all(S.dot(B)==dot(A,B))
+        assert all(S.dot(rational_csr(B)).todense()==dot(A,B))
+        assert all(S.T.todense()==A.T) and all(S.transpose().T.indices==S.indices)
+        # Coordinates: split each entry into two pieces, shuffle, and check that duplicates are summed
+        i,j = map(ravel,indices((m,n)))
+        half = A.ravel()/2
+        order = random.permutation(2*len(i))
+        C = rational_csr(hstack([half,A.ravel()-half])[order],hstack([i,i])[order],hstack([j,j])[order],(m,n))
+        assert all(C.indices==S.indices) and all(C.indptr==S.indptr) and all(C.data==S.data)
+    try:
+        rational_csr(array([1]).astype(rational),[0],[2],(2,2))
+        assert False
+    except IndexError:
+        pass
+
+def test_rational32():
+    R32 = rational32
+    x = (arange(-6,6).astype(rational)/7).astype(R32)
+    assert x.dtype==dtype(R32) and x.itemsize==8
+    assert type(x[1]) is R32 and x[1]==R(-5,7)
+    # Arithmetic widens to rational, so results past 32 bits are still exact
+    y = x*(1<<40)
+    assert y.dtype==dtype(rational) and y[1]==R(-5<<40,7)
+    assert all(x+x.astype(rational)==2*x)
+    assert add.reduce(x)==R(-6,7) and all(matmul(x.reshape(3,4),x.reshape(4,3))==matmul(x.astype(rational).reshape(3,4),x.astype(rational).reshape(4,3)))
+    assert all(x.astype(float)==x.astype(rational).astype(float))
+    assert dot(x,x)==dot(x.astype(rational),x.astype(rational)) and x.argmin()==0 and x.argmax()==11
+    # Narrowing checks that values fit
+    try:
+        y.astype(R32)
+        assert False
+    except OverflowError:
+        pass
+    try:
+        R32(1<<31)
+        assert False
+    except OverflowError:
+        pass
+    assert R32(-1<<31)==-(1<<31) and R32(1,(1<<31)-1).d==(1<<31)-1
+    x[0] = R(1,3)
+    assert x[0]==R(1,3)
+    try:
+        x[0] = R(1<<40)
+        assert False
+    except OverflowError:
+        pass
+
 if __name__=='__main__':
     test_parse()
     test_numpy_cast()
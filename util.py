@@ -43,6 +43,16 @@ def sparse_load(file):
             d[k] = v
     return d
 
+def load_combos(file='combos.bin'):
+    '''Memory map the table written by exact combos.  Entry [a,b] holds Alice's wins, Bob's wins, and ties
+    for combo a vs. combo b, where the combo with cards c0 > c1 (numbered rank+13*suit) has index c0*(c0-1)//2+c1.'''
+    return memmap(file,dtype='<u4',mode='r',shape=(1326,1326,3))
+
+def load_histograms(file='flop.bin'):
+    '''Memory map equity histograms written by exact histogram.  Entry [h,i] counts (combo,board) pairs for hand h
+    (in the order printed by exact hands) with equity vs. a random hand in the ith of equally spaced bins.'''
+    return memmap(file,dtype='<u4',mode='r').reshape(169,-1)
+
 def cvxopt_lp(c,G,h,A=None,b=None):
     assert (A is None)==(b is None)
     if A is None: